@@ -16,6 +16,8 @@ LOCAL_MODULE := libRSDriver
 
 LOCAL_SRC_FILES:= \
 	driver/rsdAllocation.cpp \
+	driver/rsdAllocationPool.cpp \
+	driver/rsdAllocationCow.cpp \
 	driver/rsdBcc.cpp \
 	driver/rsdCore.cpp \
 	driver/rsdFrameBuffer.cpp \
@@ -129,6 +131,7 @@ LOCAL_SRC_FILES:= \
 	rsAdapter.cpp \
 	rsAllocation.cpp \
 	rsAnimation.cpp \
+	rsCapture.cpp \
 	rsComponent.cpp \
 	rsContext.cpp \
 	rsDevice.cpp \
@@ -157,6 +160,7 @@ LOCAL_SRC_FILES:= \
 	rsScriptGroup.cpp \
 	rsScriptIntrinsic.cpp \
 	rsSignal.cpp \
+	rsSlab.cpp \
 	rsStream.cpp \
 	rsThreadIO.cpp \
 	rsType.cpp
@@ -221,6 +225,7 @@ LOCAL_SRC_FILES:= \
 	rsAdapter.cpp \
 	rsAllocation.cpp \
 	rsAnimation.cpp \
+	rsCapture.cpp \
 	rsComponent.cpp \
 	rsContext.cpp \
 	rsDevice.cpp \
@@ -249,6 +254,7 @@ LOCAL_SRC_FILES:= \
 	rsScriptGroup.cpp \
 	rsScriptIntrinsic.cpp \
 	rsSignal.cpp \
+	rsSlab.cpp \
 	rsStream.cpp \
 	rsThreadIO.cpp \
 	rsType.cpp
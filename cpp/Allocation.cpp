@@ -320,6 +320,44 @@ void Allocation::copy2DRangeFrom(uint32_t xoff, uint32_t yoff, uint32_t w, uint3
                             data->mSelectedLOD, data->mSelectedFace);
 }
 
+void Allocation::validate3DRange(uint32_t xoff, uint32_t yoff, uint32_t zoff,
+                                 uint32_t w, uint32_t h, uint32_t d) {
+    if (mAdaptedAllocation != NULL) {
+
+    } else {
+        if (((xoff + w) > mCurrentDimX) || ((yoff + h) > mCurrentDimY) ||
+            ((zoff + d) > mCurrentDimZ)) {
+            ALOGE("Updated region larger than allocation.");
+        }
+    }
+}
+
+void Allocation::copy3DRangeFrom(uint32_t xoff, uint32_t yoff, uint32_t zoff,
+                                 uint32_t w, uint32_t h, uint32_t d,
+                                 const void *data, size_t dataLen) {
+    validate3DRange(xoff, yoff, zoff, w, h, d);
+    rsAllocation3DData(mRS->mContext, getIDSafe(), xoff, yoff, zoff, mSelectedLOD,
+                       w, h, d, data, dataLen);
+}
+
+void Allocation::copy3DRangeFrom(uint32_t xoff, uint32_t yoff, uint32_t zoff,
+                                 uint32_t w, uint32_t h, uint32_t d,
+                                 const Allocation *data,
+                                 uint32_t dataXoff, uint32_t dataYoff, uint32_t dataZoff) {
+    validate3DRange(xoff, yoff, zoff, w, h, d);
+    rsAllocationCopy3DRange(mRS->mContext, getIDSafe(), xoff, yoff, zoff, mSelectedLOD,
+                            w, h, d, data->getIDSafe(), dataXoff, dataYoff, dataZoff,
+                            data->mSelectedLOD);
+}
+
+void Allocation::copy3DRangeTo(uint32_t xoff, uint32_t yoff, uint32_t zoff,
+                               uint32_t w, uint32_t h, uint32_t d,
+                               void *data, size_t dataLen) {
+    validate3DRange(xoff, yoff, zoff, w, h, d);
+    rsAllocation3DRead(mRS->mContext, getIDSafe(), xoff, yoff, zoff, mSelectedLOD,
+                       w, h, d, data, dataLen);
+}
+
 /*
 void copyTo(byte[] d) {
     validateIsInt8();
@@ -390,9 +428,10 @@ android::sp<Allocation> Allocation::createTyped(RenderScript *rs, sp<const Type>
 
 android::sp<Allocation> Allocation::createTyped(RenderScript *rs, sp<const Type> type,
                                     RsAllocationMipmapControl mips, uint32_t usage, void *pointer) {
-    void *id = rsAllocationCreateTyped(rs->mContext, type->getID(), mips, usage, (uint32_t)pointer);
+    void *id = rsAllocationCreateTyped(rs->mContext, type->getID(), mips, usage, (uintptr_t)pointer);
     if (id == 0) {
         ALOGE("Allocation creation failed.");
+        return NULL;
     }
     return new Allocation(id, rs, type, usage);
 }
@@ -402,6 +441,27 @@ android::sp<Allocation> Allocation::createTyped(RenderScript *rs, sp<const Type>
     return createTyped(rs, type, RS_ALLOCATION_MIPMAP_NONE, usage);
 }
 
+android::sp<Allocation> Allocation::snapshot() {
+    void *id = rsAllocationSnapshot(mRS->mContext, getIDSafe());
+    if (id == 0) {
+        ALOGE("Allocation snapshot failed.");
+        return NULL;
+    }
+    uint32_t usage = mUsage & ~(RS_ALLOCATION_USAGE_SHARED | RS_ALLOCATION_USAGE_IO_INPUT |
+                                RS_ALLOCATION_USAGE_IO_OUTPUT);
+    return new Allocation(id, mRS, mType, usage | RS_ALLOCATION_USAGE_SCRIPT);
+}
+
+android::sp<Allocation> Allocation::createFromFile(RenderScript *rs, sp<const Type> type,
+                                                   int fd, size_t offset, uint32_t usage) {
+    void *id = rsAllocationCreateFromFile(rs->mContext, type->getID(), usage, fd, offset);
+    if (id == 0) {
+        ALOGE("Allocation creation from file failed.");
+        return NULL;
+    }
+    return new Allocation(id, rs, type, usage);
+}
+
 android::sp<Allocation> Allocation::createSized(RenderScript *rs, sp<const Element> e,
         size_t count, uint32_t usage) {
 
@@ -64,6 +64,8 @@ protected:
     virtual void updateFromNative();
 
     void validate2DRange(uint32_t xoff, uint32_t yoff, uint32_t w, uint32_t h);
+    void validate3DRange(uint32_t xoff, uint32_t yoff, uint32_t zoff,
+                         uint32_t w, uint32_t h, uint32_t d);
 
 public:
     android::sp<const Type> getType() {
@@ -105,20 +107,42 @@ public:
                          const Allocation *data, size_t dataLen,
                          uint32_t dataXoff, uint32_t dataYoff);
 
+    void copy3DRangeFrom(uint32_t xoff, uint32_t yoff, uint32_t zoff,
+                         uint32_t w, uint32_t h, uint32_t d,
+                         const void *data, size_t dataLen);
+    void copy3DRangeFrom(uint32_t xoff, uint32_t yoff, uint32_t zoff,
+                         uint32_t w, uint32_t h, uint32_t d,
+                         const Allocation *data,
+                         uint32_t dataXoff, uint32_t dataYoff, uint32_t dataZoff);
+    void copy3DRangeTo(uint32_t xoff, uint32_t yoff, uint32_t zoff,
+                       uint32_t w, uint32_t h, uint32_t d,
+                       void *data, size_t dataLen);
+
     //void copyTo(byte[] d);
     //void copyTo(short[] d);
     //void copyTo(int[] d);
     //void copyTo(float[] d);
+    // Returns a copy of the current contents.  Large allocations share
+    // pages with their snapshots until either side writes them.
+    sp<Allocation> snapshot();
+
     void resize(int dimX);
     void resize(int dimX, int dimY);
 
     static sp<Allocation> createTyped(RenderScript *rs, sp<const Type> type,
                                    RsAllocationMipmapControl mips, uint32_t usage);
+    // pointer is used as the storage when usage includes
+    // RS_ALLOCATION_USAGE_SHARED, see rsDefines.h for the rules.
     static sp<Allocation> createTyped(RenderScript *rs, sp<const Type> type,
                                    RsAllocationMipmapControl mips, uint32_t usage, void * pointer);
 
     static sp<Allocation> createTyped(RenderScript *rs, sp<const Type> type,
                                    uint32_t usage = RS_ALLOCATION_USAGE_SCRIPT);
+    // Maps the packed contents of the type from fd at offset.  The fd may be
+    // closed once this returns.
+    static sp<Allocation> createFromFile(RenderScript *rs, sp<const Type> type,
+                                         int fd, size_t offset,
+                                         uint32_t usage = RS_ALLOCATION_USAGE_SCRIPT);
     static sp<Allocation> createSized(RenderScript *rs, sp<const Element> e, size_t count,
                                    uint32_t usage = RS_ALLOCATION_USAGE_SCRIPT);
     //SurfaceTexture *getSurfaceTexture();
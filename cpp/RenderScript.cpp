@@ -53,14 +53,14 @@ RenderScript::~RenderScript() {
     mDev = NULL;
 }
 
-bool RenderScript::init(int targetApi) {
+bool RenderScript::init(int targetApi, uint32_t flags) {
     mDev = rsDeviceCreate();
     if (mDev == 0) {
         ALOGE("Device creation failed");
         return false;
     }
 
-    mContext = rsContextCreate(mDev, 0, targetApi);
+    mContext = rsContextCreateWithFlags(mDev, 0, targetApi, flags);
     if (mContext == 0) {
         ALOGE("Context creation failed");
         return false;
@@ -91,7 +91,7 @@ void RenderScript::throwError(const char *err) const {
 
 void * RenderScript::threadProc(void *vrsc) {
     RenderScript *rs = static_cast<RenderScript *>(vrsc);
-    size_t rbuf_size = 256;
+    size_t rbuf_size = 4096;
     void * rbuf = malloc(rbuf_size);
 
     rsContextInitToClient(rs->mContext);
@@ -99,47 +99,63 @@ void * RenderScript::threadProc(void *vrsc) {
 
     while (rs->mMessageRun) {
         size_t receiveLen = 0;
-        uint32_t usrID = 0;
-        uint32_t subID = 0;
-        RsMessageToClientType r = rsContextPeekMessage(rs->mContext,
+        uint32_t count = 0;
+        // Blocks for the next message and returns every other message
+        // already queued along with it.
+        RsMessageToClientType r = rsContextGetMessages(rs->mContext, rbuf, rbuf_size,
                                                        &receiveLen, sizeof(receiveLen),
-                                                       &usrID, sizeof(usrID));
-
-        if (receiveLen >= rbuf_size) {
+                                                       &count, sizeof(count));
+
+        if (r == RS_MESSAGE_TO_CLIENT_RESIZE) {
+            void *buf = realloc(rbuf, receiveLen + 32);
+            if (!buf) {
+                // The message stays queued, keep the old buffer and retry
+                // rather than stopping the message thread.
+                ALOGE("RenderScript::message handler realloc error %zu", receiveLen + 32);
+                usleep(1000);
+                continue;
+            }
+            rbuf = buf;
             rbuf_size = receiveLen + 32;
-            rbuf = realloc(rbuf, rbuf_size);
-        }
-        if (!rbuf) {
-            ALOGE("RenderScript::message handler realloc error %zu", rbuf_size);
-            // No clean way to recover now?
+            continue;
         }
-        rsContextGetMessage(rs->mContext, rbuf, rbuf_size, &receiveLen, sizeof(receiveLen),
-                            &subID, sizeof(subID));
 
-        switch(r) {
-        case RS_MESSAGE_TO_CLIENT_ERROR:
-            ALOGE("RS Error %s", (const char *)rbuf);
-
-            if(rs->mMessageFunc != NULL) {
-                rs->mErrorFunc(usrID, (const char *)rbuf);
-            }
-            break;
-        case RS_MESSAGE_TO_CLIENT_EXCEPTION:
-            // teardown. But we want to avoid starving other threads during
-            // teardown by yielding until the next line in the destructor can
-            // execute to set mRun = false
-            usleep(1000);
-            break;
-        case RS_MESSAGE_TO_CLIENT_USER:
-            if(rs->mMessageFunc != NULL) {
-                rs->mMessageFunc(usrID, rbuf, receiveLen);
-            } else {
-                ALOGE("Received a message from the script with no message handler installed.");
+        const uint8_t *ptr = (const uint8_t *)rbuf;
+        for (uint32_t ct = 0; ct < count; ct++) {
+            const RsMessageToClientHeader *msg = (const RsMessageToClientHeader *)ptr;
+            const void *payload = &msg[1];
+            ptr += msg->stride;
+
+            switch(msg->msgType) {
+            case RS_MESSAGE_TO_CLIENT_ERROR:
+                ALOGE("RS Error %s", (const char *)payload);
+
+                if(rs->mMessageFunc != NULL) {
+                    rs->mErrorFunc(msg->userID, (const char *)payload);
+                }
+                break;
+            case RS_MESSAGE_TO_CLIENT_EXCEPTION:
+                // teardown. But we want to avoid starving other threads during
+                // teardown by yielding until the next line in the destructor can
+                // execute to set mRun = false
+                usleep(1000);
+                break;
+            case RS_MESSAGE_TO_CLIENT_USER:
+                if(rs->mMessageFunc != NULL) {
+                    rs->mMessageFunc(msg->userID, payload, msg->bytes);
+                } else {
+                    ALOGE("Received a message from the script with no message handler installed.");
+                }
+                break;
+
+            default:
+                ALOGE("RenderScript unknown message type %i", msg->msgType);
             }
-            break;
+        }
 
-        default:
-            ALOGE("RenderScript unknown message type %i", r);
+        if (count == 0) {
+            // The client channel was shut down.
+            usleep(1000);
         }
     }
 
@@ -159,10 +175,31 @@ void RenderScript::setMessageHandler(MessageHandlerFunc_t func) {
 }
 
 void RenderScript::contextDump() {
+    rsContextDump(mContext, 0);
 }
 
-void RenderScript::finish() {
+void RenderScript::setCommandStats(bool enable) {
+    rsContextSetCommandStats(mContext, enable);
+}
 
+void RenderScript::setAllocationPoolLimit(size_t bytes) {
+    rsContextSetAllocationPoolLimit(mContext, bytes);
+}
+
+void RenderScript::trimAllocationPool(size_t bytes) {
+    rsContextTrimAllocationPool(mContext, bytes);
+}
+
+void RenderScript::getMemoryUsage(RsMemoryUsage *usage) {
+    rsContextGetMemoryUsage(mContext, usage, sizeof(*usage));
+}
+
+uint32_t RenderScript::getCommandStats(RsCommandStats *stats, uint32_t count) {
+    return rsContextGetCommandStats(mContext, stats, count * sizeof(RsCommandStats));
+}
+
+void RenderScript::finish() {
+    rsContextFinish(mContext);
 }
 
 
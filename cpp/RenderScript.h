@@ -53,8 +53,21 @@ public:
     void setMessageHandler(MessageHandlerFunc_t func);
     MessageHandlerFunc_t getMessageHandler() {return mMessageFunc;}
 
-    bool init(int targetApi);
+    // flags is a mask of RsContextFlags.
+    bool init(int targetApi, uint32_t flags = 0);
     void contextDump();
+    // Collect per command latency histograms, reported by contextDump().
+    void setCommandStats(bool enable);
+    // Copies up to count entries, indexed by command id, and returns the
+    // number of command ids.  Pass count 0 to size the array.
+    uint32_t getCommandStats(RsCommandStats *stats, uint32_t count);
+    // Bound the memory kept for reuse by destroyed allocations, and
+    // release it down to a given size.
+    void setAllocationPoolLimit(size_t bytes);
+    void trimAllocationPool(size_t bytes = 0);
+    // Memory held by the context by RsMemoryCategory, also logged by
+    // contextDump().
+    void getMemoryUsage(RsMemoryUsage *usage);
     void finish();
 
 private:
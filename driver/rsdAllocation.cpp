@@ -18,6 +18,8 @@
 #include "rsdCore.h"
 #include "rsdRuntime.h"
 #include "rsdAllocation.h"
+#include "rsdAllocationPool.h"
+#include "rsdAllocationCow.h"
 #include "rsdFrameBufferObj.h"
 
 #include "rsAllocation.h"
@@ -32,6 +34,15 @@
 #include <GLES2/gl2.h>
 #include <GLES/glext.h>
 
+#include <errno.h>
+#include <malloc.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 using namespace android;
 using namespace android::renderscript;
 
@@ -88,6 +99,220 @@ uint8_t *GetOffsetPtr(const android::renderscript::Allocation *alloc,
     return ptr;
 }
 
+static uint8_t *GetOffsetPtr(const android::renderscript::Allocation *alloc,
+                             uint32_t xoff, uint32_t yoff, uint32_t zoff, uint32_t lod,
+                             RsAllocationCubemapFace face) {
+    DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
+    uint8_t *ptr = GetOffsetPtr(alloc, xoff, yoff, lod, face);
+    ptr += zoff * drv->lod[lod].stride * rsMax(drv->lod[lod].dimY, 1u);
+    return ptr;
+}
+
+// Describes a copy of rowCount rows of lineSize bytes, rowsPerSlice rows to
+// a slice.  Covers 2D rectangles and 3D boxes on both sides.
+struct RsdCopyRows {
+    uint8_t *dst;
+    const uint8_t *src;
+    size_t dstStride;
+    size_t srcStride;
+    size_t dstSliceStride;
+    size_t srcSliceStride;
+    size_t lineSize;
+    uint32_t rowsPerSlice;
+    uint32_t rowCount;
+
+    uint32_t chunkRows;
+    volatile int32_t nextChunk;
+};
+
+static void CopyRowRange(const RsdCopyRows *c, uint32_t start, uint32_t end) {
+    uint32_t y = start % c->rowsPerSlice;
+    uint32_t z = start / c->rowsPerSlice;
+    for (uint32_t r = start; r < end; r++) {
+        memcpy(c->dst + (z * c->dstSliceStride) + (y * c->dstStride),
+               c->src + (z * c->srcSliceStride) + (y * c->srcStride), c->lineSize);
+        if (++y == c->rowsPerSlice) {
+            y = 0;
+            z++;
+        }
+    }
+}
+
+static uint8_t *CopyRowPtr(uint8_t *base, size_t stride, size_t sliceStride,
+                           uint32_t rowsPerSlice, uint32_t row) {
+    return base + ((row / rowsPerSlice) * sliceStride) + ((row % rowsPerSlice) * stride);
+}
+
+// Copies within one allocation may overlap.  Those are done serially with
+// memmove, walking backwards when the destination is above the source.
+static bool CopyRowsOverlap(const RsdCopyRows *c) {
+    const uint8_t *dstEnd = CopyRowPtr(c->dst, c->dstStride, c->dstSliceStride,
+                                       c->rowsPerSlice, c->rowCount - 1) + c->lineSize;
+    const uint8_t *srcEnd = CopyRowPtr((uint8_t *)c->src, c->srcStride, c->srcSliceStride,
+                                       c->rowsPerSlice, c->rowCount - 1) + c->lineSize;
+    return (c->dst < srcEnd) && (c->src < dstEnd);
+}
+
+static void CopyRowsOverlapping(const RsdCopyRows *c) {
+    bool backwards = c->dst > c->src;
+    for (uint32_t i = 0; i < c->rowCount; i++) {
+        uint32_t r = backwards ? (c->rowCount - 1 - i) : i;
+        memmove(CopyRowPtr(c->dst, c->dstStride, c->dstSliceStride, c->rowsPerSlice, r),
+                CopyRowPtr((uint8_t *)c->src, c->srcStride, c->srcSliceStride,
+                           c->rowsPerSlice, r),
+                c->lineSize);
+    }
+}
+
+static void CopyRowsWorker(void *usr, uint32_t idx) {
+    RsdCopyRows *c = (RsdCopyRows *)usr;
+    while (1) {
+        uint32_t chunk = (uint32_t)android_atomic_inc(&c->nextChunk);
+        uint32_t start = chunk * c->chunkRows;
+        if (start >= c->rowCount) {
+            return;
+        }
+        CopyRowRange(c, start, rsMin(start + c->chunkRows, c->rowCount));
+    }
+}
+
+// Large copies are split across the worker threads, memcpy on a single
+// core does not saturate the memory bus.
+static void CopyRows(const Context *rsc, RsdCopyRows *c) {
+    RsdHal *dc = (RsdHal *)rsc->mHal.drv;
+    size_t total = c->lineSize * c->rowCount;
+
+    if (!c->rowCount || !c->lineSize) {
+        return;
+    }
+    if (CopyRowsOverlap(c)) {
+        CopyRowsOverlapping(c);
+        return;
+    }
+
+    if ((total < RSD_PARALLEL_COPY_THRESHOLD) || !dc->mWorkers.mCount ||
+        dc->mInForEach || (c->rowCount < 2)) {
+        CopyRowRange(c, 0, c->rowCount);
+        return;
+    }
+
+    // A few chunks per thread to even out the load, none smaller than
+    // the chunk size.
+    uint32_t threads = dc->mWorkers.mCount + 1;
+    uint32_t minRows = (uint32_t)rsMax((size_t)1, RSD_PARALLEL_COPY_CHUNK / c->lineSize);
+    c->chunkRows = rsMax(c->rowCount / (threads * 4), minRows);
+    c->nextChunk = 0;
+
+    dc->mInForEach = true;
+    rsdLaunchThreads((Context *)rsc, CopyRowsWorker, c);
+    dc->mInForEach = false;
+}
+
+
+static uint8_t * AllocationMapBuffer(size_t *size) {
+    size_t len = (*size + RSD_HUGE_PAGE_SIZE - 1) & ~(size_t)(RSD_HUGE_PAGE_SIZE - 1);
+
+#ifdef MAP_HUGETLB
+    // Explicit huge pages only succeed if the system has reserved some.
+    void *huge = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (huge != MAP_FAILED) {
+        *size = len;
+        return (uint8_t *)huge;
+    }
+#endif
+
+    // Map one huge page extra so the buffer can start on a huge page
+    // boundary, which transparent huge pages need.
+    size_t mapLen = len + RSD_HUGE_PAGE_SIZE;
+    uint8_t *map = (uint8_t *)mmap(NULL, mapLen, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    uint8_t *ptr = (uint8_t *)(((uintptr_t)map + RSD_HUGE_PAGE_SIZE - 1) &
+                               ~(uintptr_t)(RSD_HUGE_PAGE_SIZE - 1));
+    if (ptr > map) {
+        munmap(map, ptr - map);
+    }
+    size_t tail = (map + mapLen) - (ptr + len);
+    if (tail) {
+        munmap(ptr + len, tail);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(ptr, len, MADV_HUGEPAGE);
+#endif
+    *size = len;
+    return ptr;
+}
+
+static uint8_t * AllocationAllocBuffer(const Context *rsc, DrvAllocation *drv, size_t size) {
+    RsdHal *dc = (RsdHal *)rsc->mHal.drv;
+    uint8_t *ptr;
+
+    if (size >= dc->mAllocMapThreshold) {
+        size_t len = size;
+        ptr = AllocationMapBuffer(&len);
+        if (ptr) {
+            drv->storage = DrvAllocation::STORAGE_MAPPED;
+            drv->allocSize = len;
+            rsc->trackMemory(drv->category, len);
+            return ptr;
+        }
+        ALOGW("Mapping %zu bytes failed, using the heap", size);
+    }
+
+    if (dc->mAllocPool) {
+        ptr = (uint8_t *)dc->mAllocPool->alloc(size, &drv->allocSize);
+    } else {
+        if (dc->mAllocAlign > (sizeof(void *) * 2)) {
+            ptr = (uint8_t *)memalign(dc->mAllocAlign, size);
+        } else {
+            ptr = (uint8_t *)malloc(size);
+        }
+        drv->allocSize = size;
+    }
+    drv->storage = ptr ? DrvAllocation::STORAGE_HEAP : DrvAllocation::STORAGE_NONE;
+    if (ptr) {
+        rsc->trackMemory(drv->category, drv->allocSize);
+    }
+    return ptr;
+}
+
+static void AllocationFreeBuffer(const Context *rsc, DrvAllocation *drv, void *ptr) {
+    RsdHal *dc = (RsdHal *)rsc->mHal.drv;
+
+    if (drv->storage != DrvAllocation::STORAGE_NONE) {
+        rsc->trackMemory(drv->category, -(ssize_t)drv->allocSize);
+    }
+
+    switch (drv->storage) {
+    case DrvAllocation::STORAGE_HEAP:
+        if (dc->mAllocPool) {
+            dc->mAllocPool->release(ptr, drv->allocSize);
+        } else {
+            free(ptr);
+        }
+        break;
+    case DrvAllocation::STORAGE_MAPPED:
+        munmap(ptr, drv->allocSize);
+        break;
+    case DrvAllocation::STORAGE_FILE:
+        munmap((uint8_t *)ptr - drv->mapOffset, drv->allocSize);
+        break;
+    case DrvAllocation::STORAGE_COW:
+        drv->cowRegion->release((uint8_t *)ptr);
+        drv->cowRegion = NULL;
+        break;
+    default:
+        // Not ours.
+        break;
+    }
+    drv->storage = DrvAllocation::STORAGE_NONE;
+    drv->allocSize = 0;
+    drv->mapOffset = 0;
+}
+
 
 static void Update2DTexture(const Context *rsc, const Allocation *alloc, const void *ptr,
                             uint32_t xoff, uint32_t yoff, uint32_t lod,
@@ -175,7 +400,7 @@ static void UploadToTexture(const Context *rsc, const Allocation *alloc) {
 
     if (!(alloc->mHal.state.usageFlags & RS_ALLOCATION_USAGE_SCRIPT)) {
         if (alloc->mHal.drvState.mallocPtrLOD0) {
-            free(alloc->mHal.drvState.mallocPtrLOD0);
+            AllocationFreeBuffer(rsc, drv, alloc->mHal.drvState.mallocPtrLOD0);
             alloc->mHal.drvState.mallocPtrLOD0 = NULL;
             drv->lod[0].mallocPtr = NULL;
         }
@@ -229,6 +454,38 @@ static void UploadToBufferObject(const Context *rsc, const Allocation *alloc) {
     rsdGLCheckError(rsc, "UploadToBufferObject");
 }
 
+// Only allocations which are never handed to GL or to a window, and which
+// are not walked linearly (references, vec3 packing, mipmaps) get padded
+// rows.
+static bool AllocationCanPadRows(const Allocation *alloc, const Type *type) {
+    DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
+    // File contents are packed.
+    if (drv->storage == DrvAllocation::STORAGE_FILE) {
+        return false;
+    }
+    if (!type->getDimY() || type->getDimLOD() || type->getDimFaces()) {
+        return false;
+    }
+    if (alloc->mHal.state.usageFlags & ~RS_ALLOCATION_USAGE_SCRIPT) {
+        return false;
+    }
+    const Element *e = type->getElement();
+    return !e->getHasReferences() && (e->getSizeBytes() == e->getSizeBytesUnpadded());
+}
+
+static size_t AllocationRowStride(const Context *rsc, size_t rowBytes) {
+    RsdHal *dc = (RsdHal *)rsc->mHal.drv;
+    size_t align = dc->mAllocAlign;
+    size_t stride = (rowBytes + align - 1) & ~(align - 1);
+
+    // Rows a power of two apart all map to the same cache sets, so kernels
+    // reading a column of neighbours thrash.  Skew them by one line.
+    if ((align >= 16) && (stride >= 512) && !(stride & (stride - 1))) {
+        stride += align;
+    }
+    return stride;
+}
+
 static size_t AllocationBuildPointerTable(const Context *rsc, const Allocation *alloc,
         const Type *type, uint8_t *ptr) {
 
@@ -236,8 +493,12 @@ static size_t AllocationBuildPointerTable(const Context *rsc, const Allocation *
 
     drv->lod[0].dimX = type->getDimX();
     drv->lod[0].dimY = type->getDimY();
+    drv->lod[0].dimZ = type->getDimZ();
     drv->lod[0].mallocPtr = 0;
     drv->lod[0].stride = drv->lod[0].dimX * type->getElementSizeBytes();
+    if (AllocationCanPadRows(alloc, type)) {
+        drv->lod[0].stride = AllocationRowStride(rsc, drv->lod[0].stride);
+    }
     drv->lodCount = type->getLODCount();
     drv->faceCount = type->getDimFaces();
 
@@ -278,23 +539,53 @@ static size_t AllocationBuildPointerTable(const Context *rsc, const Allocation *
     return allocSize;
 }
 
+static void AllocationInitState(const Allocation *alloc, DrvAllocation *drv) {
+    drv->glTarget = GL_NONE;
+    if (alloc->mHal.state.usageFlags & RS_ALLOCATION_USAGE_GRAPHICS_TEXTURE) {
+        if (alloc->mHal.state.hasFaces) {
+            drv->glTarget = GL_TEXTURE_CUBE_MAP;
+        } else {
+            drv->glTarget = GL_TEXTURE_2D;
+        }
+    } else {
+        if (alloc->mHal.state.usageFlags & RS_ALLOCATION_USAGE_GRAPHICS_VERTEX) {
+            drv->glTarget = GL_ARRAY_BUFFER;
+        }
+    }
+
+    drv->glType = rsdTypeToGLType(alloc->mHal.state.type->getElement()->getComponent().getType());
+    drv->glFormat = rsdKindToGLFormat(alloc->mHal.state.type->getElement()->getComponent().getKind());
+
+    if (alloc->mHal.state.usageFlags & ~RS_ALLOCATION_USAGE_SCRIPT) {
+        drv->uploadDeferred = true;
+    }
+
+    drv->readBackFBO = NULL;
+}
+
 bool rsdAllocationInit(const Context *rsc, Allocation *alloc, bool forceZero) {
-    DrvAllocation *drv = (DrvAllocation *)calloc(1, sizeof(DrvAllocation));
+    DrvAllocation *drv = (DrvAllocation *)rsc->mSlabs.alloc(sizeof(DrvAllocation));
     if (!drv) {
         return false;
     }
+    memset(drv, 0, sizeof(DrvAllocation));
     alloc->mHal.drv = drv;
+    drv->category = alloc->getMemoryCategory();
 
     // Calculate the object size.
     size_t allocSize = AllocationBuildPointerTable(rsc, alloc, alloc->getType(), NULL);
 
     uint8_t * ptr = NULL;
     if (alloc->mHal.state.usageFlags & RS_ALLOCATION_USAGE_IO_OUTPUT) {
+    } else if (alloc->mHal.state.userProvidedPtr) {
+        // Left as STORAGE_NONE, the caller owns it.
+        ptr = (uint8_t *)alloc->mHal.state.userProvidedPtr;
     } else {
 
-        ptr = (uint8_t *)malloc(allocSize);
+        ptr = AllocationAllocBuffer(rsc, drv, allocSize);
         if (!ptr) {
-            free(drv);
+            SlabHeap::free(drv);
+            alloc->mHal.drv = NULL;
             return false;
         }
     }
@@ -304,38 +595,144 @@ bool rsdAllocationInit(const Context *rsc, Allocation *alloc, bool forceZero) {
         rsAssert(!"Size mismatch");
     }
 
-    drv->glTarget = GL_NONE;
-    if (alloc->mHal.state.usageFlags & RS_ALLOCATION_USAGE_GRAPHICS_TEXTURE) {
-        if (alloc->mHal.state.hasFaces) {
-            drv->glTarget = GL_TEXTURE_CUBE_MAP;
-        } else {
-            drv->glTarget = GL_TEXTURE_2D;
-        }
-    } else {
-        if (alloc->mHal.state.usageFlags & RS_ALLOCATION_USAGE_GRAPHICS_VERTEX) {
-            drv->glTarget = GL_ARRAY_BUFFER;
-        }
+    AllocationInitState(alloc, drv);
+
+    // Fresh anonymous mappings are already zero.
+    if (forceZero && ptr && (drv->storage == DrvAllocation::STORAGE_HEAP)) {
+        memset(ptr, 0, allocSize);
     }
 
-    drv->glType = rsdTypeToGLType(alloc->mHal.state.type->getElement()->getComponent().getType());
-    drv->glFormat = rsdKindToGLFormat(alloc->mHal.state.type->getElement()->getComponent().getKind());
+    return true;
+}
 
-    if (forceZero && ptr) {
-        memset(ptr, 0, alloc->mHal.state.type->getSizeBytes());
+bool rsdAllocationInitFromFile(const Context *rsc, Allocation *alloc, int fd, size_t offset) {
+    DrvAllocation *drv = (DrvAllocation *)rsc->mSlabs.alloc(sizeof(DrvAllocation));
+    if (!drv) {
+        return false;
     }
+    memset(drv, 0, sizeof(DrvAllocation));
+    alloc->mHal.drv = drv;
+    drv->category = alloc->getMemoryCategory();
+    drv->storage = DrvAllocation::STORAGE_FILE;
 
-    if (alloc->mHal.state.usageFlags & ~RS_ALLOCATION_USAGE_SCRIPT) {
-        drv->uploadDeferred = true;
+    size_t size = AllocationBuildPointerTable(rsc, alloc, alloc->getType(), NULL);
+
+    struct stat st;
+    if (fstat(fd, &st) || (offset > (size_t)st.st_size) || (size > ((size_t)st.st_size - offset))) {
+        ALOGE("File of %lld bytes too small for %zu bytes at offset %zu",
+              (long long)st.st_size, size, offset);
+        SlabHeap::free(drv);
+        alloc->mHal.drv = NULL;
+        return false;
     }
 
+    // The mapping has to start on a page boundary.  It is private so
+    // writes from scripts never reach the file, untouched pages stay
+    // shared with the page cache.
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapStart = offset & ~(page - 1);
+    size_t mapLen = (offset - mapStart) + size;
+    void *map = mmap(NULL, mapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, mapStart);
+    if (map == MAP_FAILED) {
+        ALOGE("Mapping %zu bytes of file failed, errno %i", mapLen, errno);
+        SlabHeap::free(drv);
+        alloc->mHal.drv = NULL;
+        return false;
+    }
+    drv->allocSize = mapLen;
+    drv->mapOffset = offset - mapStart;
+    rsc->trackMemory(drv->category, mapLen);
 
-    drv->readBackFBO = NULL;
+    uint8_t *ptr = (uint8_t *)map + drv->mapOffset;
+    size_t verifySize = AllocationBuildPointerTable(rsc, alloc, alloc->getType(), ptr);
+    if(size != verifySize) {
+        rsAssert(!"Size mismatch");
+    }
 
+    AllocationInitState(alloc, drv);
+    return true;
+}
+
+// Large allocations are moved into a copy on write region on their first
+// snapshot, after which snapshots share their unwritten pages.
+static uint8_t * AllocationSnapshotBuffer(const Context *rsc, DrvAllocation *srcDrv,
+                                          DrvAllocation *drv) {
+    uint8_t *srcPtr = (uint8_t *)srcDrv->lod[0].mallocPtr;
+
+    if (srcDrv->storage == DrvAllocation::STORAGE_MAPPED) {
+        RsdCowRegion *r = RsdCowRegion::adopt(srcPtr, srcDrv->allocSize);
+        if (!r) {
+            // No memfd_create in this build or kernel, or out of memory.
+            ALOGW("Allocation snapshot: unable to share %zu bytes, copying", srcDrv->allocSize);
+            return NULL;
+        }
+        srcDrv->storage = DrvAllocation::STORAGE_COW;
+        srcDrv->cowRegion = r;
+    }
+    if (srcDrv->storage != DrvAllocation::STORAGE_COW) {
+        return NULL;
+    }
+
+    uint8_t *ptr = srcDrv->cowRegion->snapshot(srcPtr);
+    if (ptr) {
+        drv->storage = DrvAllocation::STORAGE_COW;
+        drv->cowRegion = srcDrv->cowRegion;
+        drv->allocSize = srcDrv->allocSize;
+        rsc->trackMemory(drv->category, drv->allocSize);
+    }
+    return ptr;
+}
+
+bool rsdAllocationInitSnapshot(const Context *rsc, Allocation *alloc, const Allocation *src) {
+    DrvAllocation *srcDrv = (DrvAllocation *)src->mHal.drv;
+    uint8_t *srcPtr = (uint8_t *)srcDrv->lod[0].mallocPtr;
+    if (!srcPtr) {
+        return false;
+    }
+
+    DrvAllocation *drv = (DrvAllocation *)rsc->mSlabs.alloc(sizeof(DrvAllocation));
+    if (!drv) {
+        return false;
+    }
+    memset(drv, 0, sizeof(DrvAllocation));
+    alloc->mHal.drv = drv;
+    drv->category = alloc->getMemoryCategory();
+
+    // Keep the source layout, the snapshot's usage could pad differently.
+    memcpy(drv->lod, srcDrv->lod, sizeof(drv->lod));
+    drv->lodCount = srcDrv->lodCount;
+    drv->faceCount = srcDrv->faceCount;
+    drv->faceOffset = srcDrv->faceOffset;
+    size_t size = drv->faceOffset * (drv->faceCount ? 6 : 1);
+
+    uint8_t *ptr = AllocationSnapshotBuffer(rsc, srcDrv, drv);
+    ALOGV("Allocation snapshot of %p, %zu bytes, %s", src, size,
+          ptr ? "copy on write" : "full copy");
+    if (!ptr) {
+        ptr = AllocationAllocBuffer(rsc, drv, size);
+        if (!ptr) {
+            SlabHeap::free(drv);
+            alloc->mHal.drv = NULL;
+            return false;
+        }
+        memcpy(ptr, srcPtr, size);
+    }
+
+    for (uint32_t lod = 0; lod < drv->lodCount; lod++) {
+        drv->lod[lod].mallocPtr = ptr + ((uint8_t *)srcDrv->lod[lod].mallocPtr - srcPtr);
+    }
+    alloc->mHal.drvState.strideLOD0 = drv->lod[0].stride;
+    alloc->mHal.drvState.mallocPtrLOD0 = ptr;
+
+    AllocationInitState(alloc, drv);
     return true;
 }
 
 void rsdAllocationDestroy(const Context *rsc, Allocation *alloc) {
     DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
+    if (!drv) {
+        return;
+    }
 
     if (drv->bufferID) {
         // Causes a SW crash....
@@ -353,25 +750,41 @@ void rsdAllocationDestroy(const Context *rsc, Allocation *alloc) {
     }
 
     if (alloc->mHal.drvState.mallocPtrLOD0) {
-        free(alloc->mHal.drvState.mallocPtrLOD0);
+        AllocationFreeBuffer(rsc, drv, alloc->mHal.drvState.mallocPtrLOD0);
         alloc->mHal.drvState.mallocPtrLOD0 = NULL;
     }
     if (drv->readBackFBO != NULL) {
         delete drv->readBackFBO;
         drv->readBackFBO = NULL;
     }
-    free(drv);
+    SlabHeap::free(drv);
     alloc->mHal.drv = NULL;
 }
 
-void rsdAllocationResize(const Context *rsc, const Allocation *alloc,
+bool rsdAllocationResize(const Context *rsc, const Allocation *alloc,
                          const Type *newType, bool zeroNew) {
     DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
 
     void * oldPtr = drv->lod[0].mallocPtr;
+    size_t oldSize = alloc->mHal.state.type->getSizeBytes();
+    // Sizing below rewrites the tables, keep them to restore on failure.
+    DrvAllocation old = *drv;
     // Calculate the object size
     size_t s = AllocationBuildPointerTable(rsc, alloc, newType, NULL);
-    uint8_t *ptr = (uint8_t *)realloc(oldPtr, s);
+    // realloc would not keep the alignment.
+    uint8_t *ptr = AllocationAllocBuffer(rsc, drv, s);
+    if (!ptr && s) {
+        // Keep the old buffer and its tables, the allocation is unchanged.
+        *drv = old;
+        alloc->mHal.drvState.strideLOD0 = old.lod[0].stride;
+        alloc->mHal.drvState.mallocPtrLOD0 = oldPtr;
+        rsc->setError(RS_ERROR_OUT_OF_MEMORY, "Unable to resize allocation");
+        return false;
+    }
+    if (ptr && oldPtr) {
+        memcpy(ptr, oldPtr, rsMin(oldSize, s));
+    }
+    AllocationFreeBuffer(rsc, &old, oldPtr);
     // Build the relative pointer tables.
     size_t verifySize = AllocationBuildPointerTable(rsc, alloc, newType, ptr);
     if(s != verifySize) {
@@ -386,6 +799,7 @@ void rsdAllocationResize(const Context *rsc, const Allocation *alloc,
         memset(((uint8_t *)alloc->mHal.drvState.mallocPtrLOD0) + stride * oldDimX,
                  0, stride * (dimX - oldDimX));
     }
+    return true;
 }
 
 static void rsdAllocationSyncFromFBO(const Context *rsc, const Allocation *alloc) {
@@ -577,6 +991,26 @@ void rsdAllocationData1D(const Context *rsc, const Allocation *alloc,
     DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
 
     const uint32_t eSize = alloc->mHal.state.type->getElementSizeBytes();
+    const uint32_t dimX = drv->lod[0].dimX;
+
+    if (drv->lod[0].stride != (dimX * eSize)) {
+        // Padded rows, split the range at the row ends.
+        const uint8_t *src = static_cast<const uint8_t *>(data);
+        uint32_t x = xoff % dimX;
+        uint32_t y = xoff / dimX;
+        while (count) {
+            uint32_t n = rsMin(count, dimX - x);
+            uint8_t *dst = GetOffsetPtr(alloc, x, y, 0, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+            memcpy(dst, src, n * eSize);
+            src += n * eSize;
+            count -= n;
+            x = 0;
+            y++;
+        }
+        drv->uploadDeferred = true;
+        return;
+    }
+
     uint8_t * ptr = GetOffsetPtr(alloc, xoff, 0, 0, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
     uint32_t size = count * eSize;
 
@@ -620,7 +1054,41 @@ void rsdAllocationData3D(const Context *rsc, const Allocation *alloc,
                          uint32_t xoff, uint32_t yoff, uint32_t zoff,
                          uint32_t lod, RsAllocationCubemapFace face,
                          uint32_t w, uint32_t h, uint32_t d, const void *data, uint32_t sizeBytes) {
+    DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
 
+    uint32_t eSize = alloc->mHal.state.elementSizeBytes;
+    uint32_t lineSize = eSize * w;
+
+    if (!drv->lod[0].mallocPtr) {
+        ALOGE("Add code to upload 3D data to non-script memory");
+        return;
+    }
+
+    if (alloc->mHal.state.hasReferences) {
+        const uint8_t *src = static_cast<const uint8_t *>(data);
+        for (uint32_t z = zoff; z < (zoff + d); z++) {
+            for (uint32_t y = yoff; y < (yoff + h); y++) {
+                uint8_t *dst = GetOffsetPtr(alloc, xoff, y, z, lod, face);
+                alloc->incRefs(src, w);
+                alloc->decRefs(dst, w);
+                memcpy(dst, src, lineSize);
+                src += lineSize;
+            }
+        }
+    } else {
+        RsdCopyRows c;
+        c.dst = GetOffsetPtr(alloc, xoff, yoff, zoff, lod, face);
+        c.src = static_cast<const uint8_t *>(data);
+        c.dstStride = drv->lod[lod].stride;
+        c.srcStride = lineSize;
+        c.dstSliceStride = drv->lod[lod].stride * rsMax(drv->lod[lod].dimY, 1u);
+        c.srcSliceStride = lineSize * h;
+        c.lineSize = lineSize;
+        c.rowsPerSlice = h;
+        c.rowCount = h * d;
+        CopyRows(rsc, &c);
+    }
+    drv->uploadDeferred = true;
 }
 
 void rsdAllocationRead1D(const Context *rsc, const Allocation *alloc,
@@ -629,6 +1097,24 @@ void rsdAllocationRead1D(const Context *rsc, const Allocation *alloc,
     DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
 
     const uint32_t eSize = alloc->mHal.state.type->getElementSizeBytes();
+    const uint32_t dimX = drv->lod[0].dimX;
+
+    if (drv->lod[0].stride != (dimX * eSize)) {
+        uint8_t *dst = static_cast<uint8_t *>(data);
+        uint32_t x = xoff % dimX;
+        uint32_t y = xoff / dimX;
+        while (count) {
+            uint32_t n = rsMin(count, dimX - x);
+            const uint8_t *src = GetOffsetPtr(alloc, x, y, 0, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+            memcpy(dst, src, n * eSize);
+            dst += n * eSize;
+            count -= n;
+            x = 0;
+            y++;
+        }
+        return;
+    }
+
     const uint8_t * ptr = GetOffsetPtr(alloc, xoff, 0, 0, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
     memcpy(data, ptr, count * eSize);
 }
@@ -659,7 +1145,27 @@ void rsdAllocationRead3D(const Context *rsc, const Allocation *alloc,
                          uint32_t xoff, uint32_t yoff, uint32_t zoff,
                          uint32_t lod, RsAllocationCubemapFace face,
                          uint32_t w, uint32_t h, uint32_t d, void *data, uint32_t sizeBytes) {
+    DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
 
+    uint32_t eSize = alloc->mHal.state.elementSizeBytes;
+    uint32_t lineSize = eSize * w;
+
+    if (!drv->lod[0].mallocPtr) {
+        ALOGE("Add code to readback from non-script memory");
+        return;
+    }
+
+    RsdCopyRows c;
+    c.dst = static_cast<uint8_t *>(data);
+    c.src = GetOffsetPtr(alloc, xoff, yoff, zoff, lod, face);
+    c.dstStride = lineSize;
+    c.srcStride = drv->lod[lod].stride;
+    c.dstSliceStride = lineSize * h;
+    c.srcSliceStride = drv->lod[lod].stride * rsMax(drv->lod[lod].dimY, 1u);
+    c.lineSize = lineSize;
+    c.rowsPerSlice = h;
+    c.rowCount = h * d;
+    CopyRows(rsc, &c);
 }
 
 void * rsdAllocationLock1D(const android::renderscript::Context *rsc,
@@ -678,6 +1184,48 @@ void rsdAllocationData1D_alloc(const android::renderscript::Context *rsc,
                                uint32_t dstXoff, uint32_t dstLod, uint32_t count,
                                const android::renderscript::Allocation *srcAlloc,
                                uint32_t srcXoff, uint32_t srcLod) {
+    DrvAllocation *dstDrv = (DrvAllocation *)dstAlloc->mHal.drv;
+    DrvAllocation *srcDrv = (DrvAllocation *)srcAlloc->mHal.drv;
+
+    if (!dstDrv->lod[0].mallocPtr || !srcDrv->lod[0].mallocPtr) {
+        rsc->setError(RS_ERROR_FATAL_DRIVER, "Non-script allocation copies not "
+                                             "yet implemented.");
+        return;
+    }
+
+    uint32_t elementSize = dstAlloc->getType()->getElementSizeBytes();
+    uint8_t *dstPtr = GetOffsetPtr(dstAlloc, dstXoff, 0, dstLod, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+    uint8_t *srcPtr = GetOffsetPtr(srcAlloc, srcXoff, 0, srcLod, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+    size_t size = count * elementSize;
+
+    if (dstAlloc->mHal.state.hasReferences) {
+        dstAlloc->incRefs(srcPtr, count);
+        dstAlloc->decRefs(dstPtr, count);
+        memmove(dstPtr, srcPtr, size);
+    } else if ((dstPtr < (srcPtr + size)) && (srcPtr < (dstPtr + size))) {
+        memmove(dstPtr, srcPtr, size);
+    } else {
+        // Split the span into chunk sized rows so it can be spread over the
+        // workers, with whatever is left over copied as a final row.
+        size_t chunk = RSD_PARALLEL_COPY_CHUNK;
+        RsdCopyRows c;
+        c.dst = dstPtr;
+        c.src = srcPtr;
+        c.dstStride = chunk;
+        c.srcStride = chunk;
+        c.dstSliceStride = 0;
+        c.srcSliceStride = 0;
+        c.lineSize = chunk;
+        c.rowCount = size / chunk;
+        c.rowsPerSlice = rsMax(c.rowCount, 1u);
+        CopyRows(rsc, &c);
+
+        size_t tail = size - (c.rowCount * chunk);
+        if (tail) {
+            memcpy(dstPtr + (size - tail), srcPtr + (size - tail), tail);
+        }
+    }
+    dstDrv->uploadDeferred = true;
 }
 
 
@@ -688,15 +1236,32 @@ void rsdAllocationData2D_alloc_script(const android::renderscript::Context *rsc,
                                       const android::renderscript::Allocation *srcAlloc,
                                       uint32_t srcXoff, uint32_t srcYoff, uint32_t srcLod,
                                       RsAllocationCubemapFace srcFace) {
+    DrvAllocation *dstDrv = (DrvAllocation *)dstAlloc->mHal.drv;
+    DrvAllocation *srcDrv = (DrvAllocation *)srcAlloc->mHal.drv;
     uint32_t elementSize = dstAlloc->getType()->getElementSizeBytes();
-    for (uint32_t i = 0; i < h; i ++) {
-        uint8_t *dstPtr = GetOffsetPtr(dstAlloc, dstXoff, dstYoff + i, dstLod, dstFace);
-        uint8_t *srcPtr = GetOffsetPtr(srcAlloc, srcXoff, srcYoff + i, srcLod, srcFace);
-        memcpy(dstPtr, srcPtr, w * elementSize);
 
-        //ALOGE("COPIED dstXoff(%u), dstYoff(%u), dstLod(%u), dstFace(%u), w(%u), h(%u), srcXoff(%u), srcYoff(%u), srcLod(%u), srcFace(%u)",
-        //     dstXoff, dstYoff, dstLod, dstFace, w, h, srcXoff, srcYoff, srcLod, srcFace);
+    if (dstAlloc->mHal.state.hasReferences) {
+        for (uint32_t i = 0; i < h; i ++) {
+            uint8_t *dstPtr = GetOffsetPtr(dstAlloc, dstXoff, dstYoff + i, dstLod, dstFace);
+            uint8_t *srcPtr = GetOffsetPtr(srcAlloc, srcXoff, srcYoff + i, srcLod, srcFace);
+            dstAlloc->incRefs(srcPtr, w);
+            dstAlloc->decRefs(dstPtr, w);
+            memmove(dstPtr, srcPtr, w * elementSize);
+        }
+    } else {
+        RsdCopyRows c;
+        c.dst = GetOffsetPtr(dstAlloc, dstXoff, dstYoff, dstLod, dstFace);
+        c.src = GetOffsetPtr(srcAlloc, srcXoff, srcYoff, srcLod, srcFace);
+        c.dstStride = dstDrv->lod[dstLod].stride;
+        c.srcStride = srcDrv->lod[srcLod].stride;
+        c.dstSliceStride = 0;
+        c.srcSliceStride = 0;
+        c.lineSize = w * elementSize;
+        c.rowsPerSlice = rsMax(h, 1u);
+        c.rowCount = h;
+        CopyRows(rsc, &c);
     }
+    dstDrv->uploadDeferred = true;
 }
 
 void rsdAllocationData2D_alloc(const android::renderscript::Context *rsc,
@@ -724,6 +1289,43 @@ void rsdAllocationData3D_alloc(const android::renderscript::Context *rsc,
                                const android::renderscript::Allocation *srcAlloc,
                                uint32_t srcXoff, uint32_t srcYoff, uint32_t srcZoff,
                                uint32_t srcLod, RsAllocationCubemapFace srcFace) {
+    DrvAllocation *dstDrv = (DrvAllocation *)dstAlloc->mHal.drv;
+    DrvAllocation *srcDrv = (DrvAllocation *)srcAlloc->mHal.drv;
+
+    if (!dstDrv->lod[0].mallocPtr || !srcDrv->lod[0].mallocPtr) {
+        rsc->setError(RS_ERROR_FATAL_DRIVER, "Non-script allocation copies not "
+                                             "yet implemented.");
+        return;
+    }
+
+    uint32_t elementSize = dstAlloc->getType()->getElementSizeBytes();
+
+    if (dstAlloc->mHal.state.hasReferences) {
+        for (uint32_t z = 0; z < d; z++) {
+            for (uint32_t y = 0; y < h; y++) {
+                uint8_t *dstPtr = GetOffsetPtr(dstAlloc, dstXoff, dstYoff + y, dstZoff + z,
+                                               dstLod, dstFace);
+                uint8_t *srcPtr = GetOffsetPtr(srcAlloc, srcXoff, srcYoff + y, srcZoff + z,
+                                               srcLod, srcFace);
+                dstAlloc->incRefs(srcPtr, w);
+                dstAlloc->decRefs(dstPtr, w);
+                memcpy(dstPtr, srcPtr, w * elementSize);
+            }
+        }
+    } else {
+        RsdCopyRows c;
+        c.dst = GetOffsetPtr(dstAlloc, dstXoff, dstYoff, dstZoff, dstLod, dstFace);
+        c.src = GetOffsetPtr(srcAlloc, srcXoff, srcYoff, srcZoff, srcLod, srcFace);
+        c.dstStride = dstDrv->lod[dstLod].stride;
+        c.srcStride = srcDrv->lod[srcLod].stride;
+        c.dstSliceStride = dstDrv->lod[dstLod].stride * rsMax(dstDrv->lod[dstLod].dimY, 1u);
+        c.srcSliceStride = srcDrv->lod[srcLod].stride * rsMax(srcDrv->lod[srcLod].dimY, 1u);
+        c.lineSize = w * elementSize;
+        c.rowsPerSlice = h;
+        c.rowCount = h * d;
+        CopyRows(rsc, &c);
+    }
+    dstDrv->uploadDeferred = true;
 }
 
 void rsdAllocationElementData1D(const Context *rsc, const Allocation *alloc,
@@ -766,84 +1368,307 @@ void rsdAllocationElementData2D(const Context *rsc, const Allocation *alloc,
     drv->uploadDeferred = true;
 }
 
-static void mip565(const Allocation *alloc, int lod, RsAllocationCubemapFace face) {
-    DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
-    uint32_t w = drv->lod[lod + 1].dimX;
-    uint32_t h = drv->lod[lod + 1].dimY;
+#if defined(ARCH_ARM_HAVE_NEON)
+extern "C" void rsdMipmap565_K(void *dst, const void *in1, const void *in2, uint32_t count8);
+extern "C" void rsdMipmap8888_K(void *dst, const void *in1, const void *in2, uint32_t count4);
+extern "C" void rsdMipmap8_K(void *dst, const void *in1, const void *in2, uint32_t count16);
+#endif
 
-    for (uint32_t y=0; y < h; y++) {
-        uint16_t *oPtr = (uint16_t *)GetOffsetPtr(alloc, 0, y, lod + 1, face);
-        const uint16_t *i1 = (uint16_t *)GetOffsetPtr(alloc, 0, y*2, lod, face);
-        const uint16_t *i2 = (uint16_t *)GetOffsetPtr(alloc, 0, y*2+1, lod, face);
+#if defined(__SSE2__)
+// Sums of adjacent 16 bit lanes as 32 bit lanes.
+static inline __m128i PairSum16(__m128i v) {
+    return _mm_madd_epi16(v, _mm_set1_epi16(1));
+}
 
-        for (uint32_t x=0; x < w; x++) {
-            *oPtr = rsBoxFilter565(i1[0], i1[1], i2[0], i2[1]);
-            oPtr ++;
-            i1 += 2;
-            i2 += 2;
-        }
+static void Mipmap565_SSE2(uint16_t *out, const uint16_t *i1, const uint16_t *i2, uint32_t count8) {
+    const __m128i m5 = _mm_set1_epi16(0x1f);
+    const __m128i m6 = _mm_set1_epi16(0x3f);
+    for (uint32_t ct = 0; ct < count8; ct++) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)i1);
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(i1 + 8));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)i2);
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(i2 + 8));
+
+        __m128i r = _mm_packs_epi32(
+            PairSum16(_mm_add_epi16(_mm_and_si128(a0, m5), _mm_and_si128(b0, m5))),
+            PairSum16(_mm_add_epi16(_mm_and_si128(a1, m5), _mm_and_si128(b1, m5))));
+        __m128i g = _mm_packs_epi32(
+            PairSum16(_mm_add_epi16(_mm_and_si128(_mm_srli_epi16(a0, 5), m6),
+                                    _mm_and_si128(_mm_srli_epi16(b0, 5), m6))),
+            PairSum16(_mm_add_epi16(_mm_and_si128(_mm_srli_epi16(a1, 5), m6),
+                                    _mm_and_si128(_mm_srli_epi16(b1, 5), m6))));
+        __m128i b = _mm_packs_epi32(
+            PairSum16(_mm_add_epi16(_mm_srli_epi16(a0, 11), _mm_srli_epi16(b0, 11))),
+            PairSum16(_mm_add_epi16(_mm_srli_epi16(a1, 11), _mm_srli_epi16(b1, 11))));
+
+        __m128i o = _mm_or_si128(_mm_srli_epi16(r, 2),
+                    _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(g, 2), 5),
+                                 _mm_slli_epi16(_mm_srli_epi16(b, 2), 11)));
+        _mm_storeu_si128((__m128i *)out, o);
+        out += 8;
+        i1 += 16;
+        i2 += 16;
     }
 }
 
-static void mip8888(const Allocation *alloc, int lod, RsAllocationCubemapFace face) {
-    DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
-    uint32_t w = drv->lod[lod + 1].dimX;
-    uint32_t h = drv->lod[lod + 1].dimY;
+static void Mipmap8888_SSE2(uint32_t *out, const uint32_t *i1, const uint32_t *i2, uint32_t count4) {
+    const __m128i z = _mm_setzero_si128();
+    for (uint32_t ct = 0; ct < count4; ct++) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)i1);
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(i1 + 4));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)i2);
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(i2 + 4));
+
+        // Each 64 bit half holds one widened pixel, sum the two rows then
+        // the even and odd pixels.
+        __m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, z), _mm_unpacklo_epi8(b0, z));
+        __m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, z), _mm_unpackhi_epi8(b0, z));
+        __m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, z), _mm_unpacklo_epi8(b1, z));
+        __m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, z), _mm_unpackhi_epi8(b1, z));
+        __m128i o01 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+        __m128i o23 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+
+        _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(_mm_srli_epi16(o01, 2),
+                                                           _mm_srli_epi16(o23, 2)));
+        out += 4;
+        i1 += 8;
+        i2 += 8;
+    }
+}
+
+static void Mipmap8_SSE2(uint8_t *out, const uint8_t *i1, const uint8_t *i2, uint32_t count16) {
+    const __m128i z = _mm_setzero_si128();
+    for (uint32_t ct = 0; ct < count16; ct++) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)i1);
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(i1 + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)i2);
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(i2 + 16));
+
+        __m128i o0 = _mm_packs_epi32(
+            PairSum16(_mm_add_epi16(_mm_unpacklo_epi8(a0, z), _mm_unpacklo_epi8(b0, z))),
+            PairSum16(_mm_add_epi16(_mm_unpackhi_epi8(a0, z), _mm_unpackhi_epi8(b0, z))));
+        __m128i o1 = _mm_packs_epi32(
+            PairSum16(_mm_add_epi16(_mm_unpacklo_epi8(a1, z), _mm_unpacklo_epi8(b1, z))),
+            PairSum16(_mm_add_epi16(_mm_unpackhi_epi8(a1, z), _mm_unpackhi_epi8(b1, z))));
+
+        _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(_mm_srli_epi16(o0, 2),
+                                                           _mm_srli_epi16(o1, 2)));
+        out += 16;
+        i1 += 32;
+        i2 += 32;
+    }
+}
+#endif
+
+// Each filter writes output pixels [x1, x2) of one row.  The caller
+// guarantees both source pixels of each output exist below pairs, the
+// remainder only has one source column.
+static void mip565(uint8_t *vout, const uint8_t *vi1, const uint8_t *vi2,
+                   uint32_t x1, uint32_t x2, uint32_t pairs, uint32_t comps) {
+    uint16_t *oPtr = (uint16_t *)vout;
+    const uint16_t *i1 = (const uint16_t *)vi1;
+    const uint16_t *i2 = (const uint16_t *)vi2;
+
+#if defined(ARCH_ARM_HAVE_NEON)
+    if ((x1 + 8) <= pairs) {
+        uint32_t len = (pairs - x1) >> 3;
+        rsdMipmap565_K(oPtr + x1, i1 + x1 * 2, i2 + x1 * 2, len);
+        x1 += len << 3;
+    }
+#elif defined(__SSE2__)
+    if ((x1 + 8) <= pairs) {
+        uint32_t len = (pairs - x1) >> 3;
+        Mipmap565_SSE2(oPtr + x1, i1 + x1 * 2, i2 + x1 * 2, len);
+        x1 += len << 3;
+    }
+#endif
+    for (; x1 < x2; x1++) {
+        uint32_t x = x1 * 2;
+        uint32_t xn = (x1 < pairs) ? (x + 1) : x;
+        oPtr[x1] = rsBoxFilter565(i1[x], i1[xn], i2[x], i2[xn]);
+    }
+}
+
+static void mip8888(uint8_t *vout, const uint8_t *vi1, const uint8_t *vi2,
+                    uint32_t x1, uint32_t x2, uint32_t pairs, uint32_t comps) {
+    uint32_t *oPtr = (uint32_t *)vout;
+    const uint32_t *i1 = (const uint32_t *)vi1;
+    const uint32_t *i2 = (const uint32_t *)vi2;
+
+#if defined(ARCH_ARM_HAVE_NEON)
+    if ((x1 + 4) <= pairs) {
+        uint32_t len = (pairs - x1) >> 2;
+        rsdMipmap8888_K(oPtr + x1, i1 + x1 * 2, i2 + x1 * 2, len);
+        x1 += len << 2;
+    }
+#elif defined(__SSE2__)
+    if ((x1 + 4) <= pairs) {
+        uint32_t len = (pairs - x1) >> 2;
+        Mipmap8888_SSE2(oPtr + x1, i1 + x1 * 2, i2 + x1 * 2, len);
+        x1 += len << 2;
+    }
+#endif
+    for (; x1 < x2; x1++) {
+        uint32_t x = x1 * 2;
+        uint32_t xn = (x1 < pairs) ? (x + 1) : x;
+        oPtr[x1] = rsBoxFilter8888(i1[x], i1[xn], i2[x], i2[xn]);
+    }
+}
 
-    for (uint32_t y=0; y < h; y++) {
-        uint32_t *oPtr = (uint32_t *)GetOffsetPtr(alloc, 0, y, lod + 1, face);
-        const uint32_t *i1 = (uint32_t *)GetOffsetPtr(alloc, 0, y*2, lod, face);
-        const uint32_t *i2 = (uint32_t *)GetOffsetPtr(alloc, 0, y*2+1, lod, face);
+static void mip8(uint8_t *oPtr, const uint8_t *i1, const uint8_t *i2,
+                 uint32_t x1, uint32_t x2, uint32_t pairs, uint32_t comps) {
+#if defined(ARCH_ARM_HAVE_NEON)
+    if ((x1 + 16) <= pairs) {
+        uint32_t len = (pairs - x1) >> 4;
+        rsdMipmap8_K(oPtr + x1, i1 + x1 * 2, i2 + x1 * 2, len);
+        x1 += len << 4;
+    }
+#elif defined(__SSE2__)
+    if ((x1 + 16) <= pairs) {
+        uint32_t len = (pairs - x1) >> 4;
+        Mipmap8_SSE2(oPtr + x1, i1 + x1 * 2, i2 + x1 * 2, len);
+        x1 += len << 4;
+    }
+#endif
+    for (; x1 < x2; x1++) {
+        uint32_t x = x1 * 2;
+        uint32_t xn = (x1 < pairs) ? (x + 1) : x;
+        oPtr[x1] = (uint8_t)(((uint32_t)i1[x] + i1[xn] + i2[x] + i2[xn]) >> 2);
+    }
+}
 
-        for (uint32_t x=0; x < w; x++) {
-            *oPtr = rsBoxFilter8888(i1[0], i1[1], i2[0], i2[1]);
-            oPtr ++;
-            i1 += 2;
-            i2 += 2;
+// Float elements of any vector size, comps floats to an element.
+static void mipFloat(uint8_t *vout, const uint8_t *vi1, const uint8_t *vi2,
+                     uint32_t x1, uint32_t x2, uint32_t pairs, uint32_t comps) {
+    float *oPtr = (float *)vout;
+    const float *i1 = (const float *)vi1;
+    const float *i2 = (const float *)vi2;
+
+    for (; x1 < x2; x1++) {
+        uint32_t x = x1 * 2 * comps;
+        uint32_t xn = (x1 < pairs) ? (x + comps) : x;
+        for (uint32_t c = 0; c < comps; c++) {
+            oPtr[x1 * comps + c] = (i1[x + c] + i1[xn + c] + i2[x + c] + i2[xn + c]) * 0.25f;
         }
     }
 }
 
-static void mip8(const Allocation *alloc, int lod, RsAllocationCubemapFace face) {
-    DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
-    uint32_t w = drv->lod[lod + 1].dimX;
-    uint32_t h = drv->lod[lod + 1].dimY;
+typedef void (*MipmapFilter_t)(uint8_t *out, const uint8_t *i1, const uint8_t *i2,
+                               uint32_t x1, uint32_t x2, uint32_t pairs, uint32_t comps);
+
+struct RsdMipmapLevel {
+    const Allocation *alloc;
+    MipmapFilter_t filter;
+    uint32_t comps;
+    uint32_t lod;
+    RsAllocationCubemapFace face;
+
+    uint32_t rowCount;
+    uint32_t chunkRows;
+    volatile int32_t nextChunk;
+};
 
-    for (uint32_t y=0; y < h; y++) {
-        uint8_t *oPtr = GetOffsetPtr(alloc, 0, y, lod + 1, face);
-        const uint8_t *i1 = GetOffsetPtr(alloc, 0, y*2, lod, face);
-        const uint8_t *i2 = GetOffsetPtr(alloc, 0, y*2+1, lod, face);
+static void MipmapRows(const RsdMipmapLevel *m, uint32_t y1, uint32_t y2) {
+    DrvAllocation *drv = (DrvAllocation *)m->alloc->mHal.drv;
+    uint32_t w = drv->lod[m->lod + 1].dimX;
+    uint32_t srcH = rsMax(drv->lod[m->lod].dimY, 1u);
+    uint32_t pairs = rsMin(w, drv->lod[m->lod].dimX >> 1);
+
+    for (uint32_t y = y1; y < y2; y++) {
+        uint32_t yn = rsMin(y * 2 + 1, srcH - 1);
+        m->filter(GetOffsetPtr(m->alloc, 0, y, m->lod + 1, m->face),
+                  GetOffsetPtr(m->alloc, 0, y * 2, m->lod, m->face),
+                  GetOffsetPtr(m->alloc, 0, yn, m->lod, m->face),
+                  0, w, pairs, m->comps);
+    }
+}
 
-        for (uint32_t x=0; x < w; x++) {
-            *oPtr = (uint8_t)(((uint32_t)i1[0] + i1[1] + i2[0] + i2[1]) * 0.25f);
-            oPtr ++;
-            i1 += 2;
-            i2 += 2;
+static void MipmapWorker(void *usr, uint32_t idx) {
+    RsdMipmapLevel *m = (RsdMipmapLevel *)usr;
+    while (1) {
+        uint32_t chunk = (uint32_t)android_atomic_inc(&m->nextChunk);
+        uint32_t start = chunk * m->chunkRows;
+        if (start >= m->rowCount) {
+            return;
         }
+        MipmapRows(m, start, rsMin(start + m->chunkRows, m->rowCount));
     }
 }
 
+// Levels depend on the previous one so they run in order, the rows of a
+// large level are spread over the workers.
+static void MipmapLevel(const Context *rsc, RsdMipmapLevel *m) {
+    RsdHal *dc = (RsdHal *)rsc->mHal.drv;
+    DrvAllocation *drv = (DrvAllocation *)m->alloc->mHal.drv;
+
+    m->rowCount = rsMax(drv->lod[m->lod + 1].dimY, 1u);
+    size_t bytes = drv->lod[m->lod].stride * rsMax(drv->lod[m->lod].dimY, 1u);
+    if ((bytes < RSD_PARALLEL_COPY_THRESHOLD) || !dc->mWorkers.mCount ||
+        dc->mInForEach || (m->rowCount < 2)) {
+        MipmapRows(m, 0, m->rowCount);
+        return;
+    }
+
+    uint32_t threads = dc->mWorkers.mCount + 1;
+    m->chunkRows = rsMax(m->rowCount / (threads * 4), 1u);
+    m->nextChunk = 0;
+
+    dc->mInForEach = true;
+    rsdLaunchThreads((Context *)rsc, MipmapWorker, m);
+    dc->mInForEach = false;
+}
+
 void rsdAllocationGenerateMipmaps(const Context *rsc, const Allocation *alloc) {
     DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
     if(!drv->lod[0].mallocPtr) {
         return;
     }
+
+    const Element *e = alloc->getType()->getElement();
+    RsdMipmapLevel m;
+    m.alloc = alloc;
+    m.comps = 1;
+    if (e->getType() == RS_TYPE_FLOAT_32) {
+        m.filter = mipFloat;
+        m.comps = e->getSizeBytes() / sizeof(float);
+    } else {
+        switch (e->getSizeBits()) {
+        case 32:
+            m.filter = mip8888;
+            break;
+        case 16:
+            m.filter = mip565;
+            break;
+        case 8:
+            m.filter = mip8;
+            break;
+        default:
+            return;
+        }
+    }
+
     uint32_t numFaces = alloc->getType()->getDimFaces() ? 6 : 1;
     for (uint32_t face = 0; face < numFaces; face ++) {
+        m.face = (RsAllocationCubemapFace)face;
         for (uint32_t lod=0; lod < (alloc->getType()->getLODCount() -1); lod++) {
-            switch (alloc->getType()->getElement()->getSizeBits()) {
-            case 32:
-                mip8888(alloc, lod, (RsAllocationCubemapFace)face);
-                break;
-            case 16:
-                mip565(alloc, lod, (RsAllocationCubemapFace)face);
-                break;
-            case 8:
-                mip8(alloc, lod, (RsAllocationCubemapFace)face);
-                break;
-            }
+            m.lod = lod;
+            MipmapLevel(rsc, &m);
         }
     }
 }
 
 
+
+void rsdAllocationSetPoolLimit(const Context *rsc, size_t bytes) {
+    RsdHal *dc = (RsdHal *)rsc->mHal.drv;
+    if (dc->mAllocPool) {
+        dc->mAllocPool->setLimit(bytes);
+    }
+}
+
+void rsdAllocationTrimPool(const Context *rsc, size_t bytes) {
+    RsdHal *dc = (RsdHal *)rsc->mHal.drv;
+    if (dc->mAllocPool) {
+        dc->mAllocPool->trim(bytes);
+    }
+}
@@ -25,8 +25,25 @@
 #include <GLES2/gl2.h>
 
 class RsdFrameBufferObj;
+class RsdCowRegion;
 struct ANativeWindowBuffer;
 
+// Default alignment of allocation storage, and of the rows of script only 2D
+// allocations.  Can be overridden with debug.rs.alloc.align, a value of 1
+// gives the old packed layout.
+#define RSD_ALLOCATION_ALIGN 64
+
+// Allocations at least this large are backed by their own anonymous mapping
+// rather than the heap, using huge pages where the kernel provides them.
+// Overridden by debug.rs.alloc.mmap-threshold, in bytes.
+#define RSD_ALLOCATION_MMAP_THRESHOLD (64 * 1024 * 1024)
+#define RSD_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// Copies of at least this many bytes are split across the worker threads
+// in chunks of roughly RSD_PARALLEL_COPY_CHUNK bytes.
+#define RSD_PARALLEL_COPY_THRESHOLD (512 * 1024)
+#define RSD_PARALLEL_COPY_CHUNK (64 * 1024)
+
 struct DrvAllocation {
     // Is this a legal structure to be used as a texture source.
     // Initially this will require 1D or 2D and color data
@@ -61,7 +78,20 @@ struct DrvAllocation {
     uint32_t lodCount;
     uint32_t faceCount;
 
-
+    // Where the buffer behind lod[0].mallocPtr came from, and its size.
+    enum {
+        STORAGE_NONE,       // Not owned by the driver, e.g. a window buffer.
+        STORAGE_HEAP,       // From the allocation pool.
+        STORAGE_MAPPED,     // Anonymous mapping, for large allocations.
+        STORAGE_FILE,       // Private mapping of a file region.
+        STORAGE_COW         // Shared with snapshots through cowRegion.
+    } storage;
+    size_t allocSize;
+    // For STORAGE_FILE, bytes from the start of the mapping to lod[0].
+    size_t mapOffset;
+    RsdCowRegion *cowRegion;
+    // Where allocSize is counted, see Context::trackMemory.
+    RsMemoryCategory category;
 };
 
 GLenum rsdTypeToGLType(RsDataType t);
@@ -71,10 +101,16 @@ GLenum rsdKindToGLFormat(RsDataKind k);
 bool rsdAllocationInit(const android::renderscript::Context *rsc,
                        android::renderscript::Allocation *alloc,
                        bool forceZero);
+bool rsdAllocationInitFromFile(const android::renderscript::Context *rsc,
+                               android::renderscript::Allocation *alloc,
+                               int fd, size_t offset);
+bool rsdAllocationInitSnapshot(const android::renderscript::Context *rsc,
+                               android::renderscript::Allocation *alloc,
+                               const android::renderscript::Allocation *src);
 void rsdAllocationDestroy(const android::renderscript::Context *rsc,
                           android::renderscript::Allocation *alloc);
 
-void rsdAllocationResize(const android::renderscript::Context *rsc,
+bool rsdAllocationResize(const android::renderscript::Context *rsc,
                          const android::renderscript::Allocation *alloc,
                          const android::renderscript::Type *newType, bool zeroNew);
 void rsdAllocationSyncAll(const android::renderscript::Context *rsc,
@@ -160,6 +196,9 @@ void rsdAllocationElementData2D(const android::renderscript::Context *rsc,
 void rsdAllocationGenerateMipmaps(const android::renderscript::Context *rsc,
                                   const android::renderscript::Allocation *alloc);
 
+void rsdAllocationSetPoolLimit(const android::renderscript::Context *rsc, size_t bytes);
+void rsdAllocationTrimPool(const android::renderscript::Context *rsc, size_t bytes);
+
 
 
 #endif
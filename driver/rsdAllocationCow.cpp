@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rsdAllocationCow.h"
+#include "rsUtils.h"
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+using namespace android;
+using namespace android::renderscript;
+
+// Pages examined per read of /proc/self/pagemap.
+#define RSD_COW_BATCH 512
+
+#define PAGEMAP_PRESENT (1ull << 63)
+#define PAGEMAP_SWAPPED (1ull << 62)
+#define PAGEMAP_FILE    (1ull << 61)
+
+static int createMemoryFile(size_t size) {
+#if defined(__NR_memfd_create)
+    int fd = syscall(__NR_memfd_create, "rs-allocation", 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, size)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+static bool writeAll(int fd, const uint8_t *data, size_t size, off_t offset) {
+    while (size) {
+        ssize_t ret = pwrite(fd, data, size, offset);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += ret;
+        size -= ret;
+        offset += ret;
+    }
+    return true;
+}
+
+RsdCowRegion::RsdCowRegion(int fd, size_t size) {
+    mLock.init();
+    mFd = fd;
+    mSize = size;
+    mPageSize = (size_t)sysconf(_SC_PAGESIZE);
+}
+
+RsdCowRegion::~RsdCowRegion() {
+    close(mFd);
+}
+
+RsdCowRegion * RsdCowRegion::adopt(uint8_t *ptr, size_t size) {
+    int fd = createMemoryFile(size);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (!writeAll(fd, ptr, size, 0)) {
+        close(fd);
+        return NULL;
+    }
+    if (mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        // The old mapping is still in place.
+        close(fd);
+        return NULL;
+    }
+
+    RsdCowRegion *r = new RsdCowRegion(fd, size);
+    r->mMappings.push(ptr);
+    return r;
+}
+
+// Sets isPrivate for each page that holds a private copy, resident or
+// swapped out, rather than reading through to the file.
+bool RsdCowRegion::readPrivatePages(int pagemap, const uint8_t *ptr, size_t first, size_t count,
+                                    uint8_t *isPrivate) const {
+    uint64_t entries[RSD_COW_BATCH];
+    off_t offset = (((uintptr_t)ptr / mPageSize) + first) * sizeof(uint64_t);
+    size_t bytes = count * sizeof(uint64_t);
+
+    if ((pagemap < 0) || (pread(pagemap, entries, bytes, offset) != (ssize_t)bytes)) {
+        return false;
+    }
+    for (size_t ct = 0; ct < count; ct++) {
+        uint64_t e = entries[ct];
+        isPrivate[ct] = ((e & PAGEMAP_PRESENT) && !(e & PAGEMAP_FILE)) || (e & PAGEMAP_SWAPPED);
+    }
+    return true;
+}
+
+bool RsdCowRegion::syncLocked(uint8_t *ptr) {
+    int pagemap = open("/proc/self/pagemap", O_RDONLY);
+    size_t pageCount = mSize / mPageSize;
+    uint8_t dirty[RSD_COW_BATCH];
+    uint8_t other[RSD_COW_BATCH];
+    bool ok = true;
+
+    for (size_t base = 0; ok && (base < pageCount); base += RSD_COW_BATCH) {
+        size_t count = rsMin((size_t)RSD_COW_BATCH, pageCount - base);
+        // Without the page map every page has to be treated as written.
+        if (!readPrivatePages(pagemap, ptr, base, count, dirty)) {
+            memset(dirty, 1, count);
+        }
+
+        size_t run = 0;
+        while (run < count) {
+            if (!dirty[run]) {
+                run++;
+                continue;
+            }
+            size_t end = run;
+            while ((end < count) && dirty[end]) {
+                end++;
+            }
+
+            // Pages the other mappings still read from the file get their
+            // own copy before the file changes.
+            for (size_t m = 0; m < mMappings.size(); m++) {
+                uint8_t *map = mMappings[m];
+                if (map == ptr) {
+                    continue;
+                }
+                if (!readPrivatePages(pagemap, map, base + run, end - run, other)) {
+                    memset(other, 0, end - run);
+                }
+                for (size_t p = run; p < end; p++) {
+                    if (!other[p - run]) {
+                        volatile uint8_t *v = map + (base + p) * mPageSize;
+                        *v = *v;
+                    }
+                }
+            }
+
+            size_t offset = (base + run) * mPageSize;
+            size_t bytes = (end - run) * mPageSize;
+            if (!writeAll(mFd, ptr + offset, bytes, offset) ||
+                (mmap(ptr + offset, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                      mFd, offset) == MAP_FAILED)) {
+                ok = false;
+                break;
+            }
+            run = end;
+        }
+    }
+
+    if (pagemap >= 0) {
+        close(pagemap);
+    }
+    return ok;
+}
+
+uint8_t * RsdCowRegion::snapshot(uint8_t *ptr) {
+    mLock.lock();
+    if (!syncLocked(ptr)) {
+        mLock.unlock();
+        ALOGE("Syncing copy on write region failed, errno %i", errno);
+        return NULL;
+    }
+    void *map = mmap(NULL, mSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, mFd, 0);
+    if (map == MAP_FAILED) {
+        mLock.unlock();
+        return NULL;
+    }
+    mMappings.push((uint8_t *)map);
+    mLock.unlock();
+    return (uint8_t *)map;
+}
+
+void RsdCowRegion::release(uint8_t *ptr) {
+    mLock.lock();
+    munmap(ptr, mSize);
+    for (size_t ct = 0; ct < mMappings.size(); ct++) {
+        if (mMappings[ct] == ptr) {
+            mMappings.removeAt(ct);
+            break;
+        }
+    }
+    bool last = mMappings.isEmpty();
+    mLock.unlock();
+
+    if (last) {
+        delete this;
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RSD_ALLOCATION_COW_H
+#define RSD_ALLOCATION_COW_H
+
+#include "rsMutex.h"
+
+#include <utils/Vector.h>
+
+// Backing store shared copy on write between an allocation and its
+// snapshots.  Every user holds a private mapping of one memory file, so
+// pages nobody has written since the last snapshot are shared.
+//
+// Taking a snapshot first folds the pages the source has written into the
+// file.  Before a page of the file changes, each other mapping that still
+// reads it from the file is given its own copy, so snapshots only cost
+// time for pages written since the previous one.
+class RsdCowRegion {
+public:
+    // Moves the contents of the page aligned mapping at ptr into a new
+    // region and maps ptr privately from it in place.  Returns NULL if the
+    // kernel cannot provide a memory file.
+    static RsdCowRegion * adopt(uint8_t *ptr, size_t size);
+
+    // Returns a new mapping holding the current contents of ptr, which must
+    // be a mapping of this region.
+    uint8_t * snapshot(uint8_t *ptr);
+
+    // Unmaps ptr.  The region is deleted along with its last mapping.
+    void release(uint8_t *ptr);
+
+protected:
+    RsdCowRegion(int fd, size_t size);
+    ~RsdCowRegion();
+
+    bool readPrivatePages(int pagemap, const uint8_t *ptr, size_t first, size_t count,
+                          uint8_t *isPrivate) const;
+    bool syncLocked(uint8_t *ptr);
+
+    android::renderscript::Mutex mLock;
+    int mFd;
+    size_t mSize;
+    size_t mPageSize;
+    android::Vector<uint8_t *> mMappings;
+};
+
+#endif
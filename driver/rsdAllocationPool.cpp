@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rsdAllocationPool.h"
+#include "rsContext.h"
+
+#include <malloc.h>
+
+using namespace android;
+using namespace android::renderscript;
+
+RsdAllocationPool::RsdAllocationPool(const Context *rsc, size_t align, size_t limit) {
+    mLock.init();
+    mRSC = rsc;
+    mAlign = align;
+    mLimit = limit;
+    mHeldBytes = 0;
+    mHeldCount = 0;
+    mAllocCount = 0;
+    mHitCount = 0;
+    mReleaseCount = 0;
+    mDropCount = 0;
+}
+
+RsdAllocationPool::~RsdAllocationPool() {
+    trimLocked(0);
+}
+
+size_t RsdAllocationPool::getClass(size_t size, uint32_t *index) {
+    if (size <= ((size_t)1 << MIN_SHIFT)) {
+        *index = 0;
+        return (size_t)1 << MIN_SHIFT;
+    }
+
+    // 2^shift < size <= 2^(shift + 1), split in four steps.
+    uint32_t shift = (sizeof(unsigned long) * 8 - 1) - __builtin_clzl(size - 1);
+    size_t step = (size_t)1 << (shift - 2);
+    size_t rounded = (size + step - 1) & ~(step - 1);
+    *index = (shift - MIN_SHIFT) * 4 + (uint32_t)(rounded >> (shift - 2)) - 4;
+    return rounded;
+}
+
+size_t RsdAllocationPool::getClassSize(uint32_t index) {
+    if (!index) {
+        return (size_t)1 << MIN_SHIFT;
+    }
+    uint32_t shift = MIN_SHIFT + (index - 1) / 4;
+    return (size_t)(5 + (index - 1) % 4) << (shift - 2);
+}
+
+void * RsdAllocationPool::alloc(size_t size, size_t *allocSize) {
+    uint32_t idx;
+    size_t classSize = getClass(size, &idx);
+
+    mLock.lock();
+    mAllocCount++;
+    if (!mFree[idx].isEmpty()) {
+        void *ptr = mFree[idx].top();
+        mFree[idx].pop();
+        mHeldBytes -= classSize;
+        mHeldCount--;
+        mHitCount++;
+        mLock.unlock();
+        mRSC->trackMemory(RS_MEMORY_ALLOCATION_POOL, -(ssize_t)classSize);
+        *allocSize = classSize;
+        return ptr;
+    }
+    mLock.unlock();
+
+    void *ptr;
+    if (mAlign > (sizeof(void *) * 2)) {
+        ptr = memalign(mAlign, classSize);
+    } else {
+        ptr = malloc(classSize);
+    }
+    *allocSize = ptr ? classSize : 0;
+    return ptr;
+}
+
+void RsdAllocationPool::release(void *ptr, size_t allocSize) {
+    if (!ptr) {
+        return;
+    }
+
+    uint32_t idx;
+    size_t classSize = getClass(allocSize, &idx);
+    rsAssert(classSize == allocSize);
+
+    mLock.lock();
+    mReleaseCount++;
+    if ((mHeldBytes + classSize) > mLimit) {
+        mDropCount++;
+        mLock.unlock();
+        free(ptr);
+        return;
+    }
+    mFree[idx].push(ptr);
+    mHeldBytes += classSize;
+    mHeldCount++;
+    mLock.unlock();
+    mRSC->trackMemory(RS_MEMORY_ALLOCATION_POOL, classSize);
+}
+
+void RsdAllocationPool::trimLocked(size_t bytes) {
+    size_t held = mHeldBytes;
+    for (int32_t idx = CLASS_COUNT - 1; (idx >= 0) && (mHeldBytes > bytes); idx--) {
+        size_t classSize = getClassSize(idx);
+        while (!mFree[idx].isEmpty() && (mHeldBytes > bytes)) {
+            free(mFree[idx].top());
+            mFree[idx].pop();
+            mHeldBytes -= classSize;
+            mHeldCount--;
+        }
+    }
+    if (held != mHeldBytes) {
+        mRSC->trackMemory(RS_MEMORY_ALLOCATION_POOL, -(ssize_t)(held - mHeldBytes));
+    }
+}
+
+void RsdAllocationPool::trim(size_t bytes) {
+    mLock.lock();
+    trimLocked(bytes);
+    mLock.unlock();
+}
+
+void RsdAllocationPool::setLimit(size_t bytes) {
+    mLock.lock();
+    mLimit = bytes;
+    trimLocked(bytes);
+    mLock.unlock();
+}
+
+void RsdAllocationPool::dumpStats() const {
+    mLock.lock();
+    uint32_t hitPercent = mAllocCount ? (uint32_t)((mHitCount * 100) / mAllocCount) : 0;
+    ALOGV("Allocation pool: %llu allocs, %llu hits (%u%%), %llu released, %llu dropped",
+          (unsigned long long)mAllocCount, (unsigned long long)mHitCount, hitPercent,
+          (unsigned long long)mReleaseCount, (unsigned long long)mDropCount);
+    ALOGV("Allocation pool: %zu bytes held in %zu buffers, limit %zu",
+          mHeldBytes, mHeldCount, mLimit);
+    mLock.unlock();
+}
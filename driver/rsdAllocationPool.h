@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RSD_ALLOCATION_POOL_H
+#define RSD_ALLOCATION_POOL_H
+
+#include "rsMutex.h"
+
+#include <utils/Vector.h>
+
+namespace android {
+namespace renderscript {
+class Context;
+}
+}
+
+// Default number of bytes of released allocation storage kept for reuse.
+#define RSD_ALLOCATION_POOL_LIMIT (16 * 1024 * 1024)
+
+// Recycles allocation backing stores.  Requests are rounded up to a size
+// class, four classes per power of two, and released buffers are kept on a
+// free list per class until the pool holds more than its limit.  Held
+// bytes are counted as RS_MEMORY_ALLOCATION_POOL in the context.
+class RsdAllocationPool {
+public:
+    RsdAllocationPool(const android::renderscript::Context *rsc, size_t align, size_t limit);
+    ~RsdAllocationPool();
+
+    // Returns a buffer of at least size bytes, the usable size is returned
+    // in allocSize and must be passed back to release.
+    void * alloc(size_t size, size_t *allocSize);
+    void release(void *ptr, size_t allocSize);
+
+    // Frees held buffers, largest first, until at most bytes are held.
+    void trim(size_t bytes);
+    void setLimit(size_t bytes);
+
+    void dumpStats() const;
+
+protected:
+    static const uint32_t MIN_SHIFT = 6;
+    static const uint32_t CLASS_COUNT = (sizeof(size_t) * 8 - MIN_SHIFT) * 4 + 1;
+
+    static size_t getClass(size_t size, uint32_t *index);
+    static size_t getClassSize(uint32_t index);
+    void trimLocked(size_t bytes);
+
+    mutable android::renderscript::Mutex mLock;
+    const android::renderscript::Context *mRSC;
+    size_t mAlign;
+    size_t mLimit;
+
+    android::Vector<void *> mFree[CLASS_COUNT];
+    size_t mHeldBytes;
+    size_t mHeldCount;
+
+    uint64_t mAllocCount;
+    uint64_t mHitCount;
+    uint64_t mReleaseCount;
+    uint64_t mDropCount;
+};
+
+#endif
@@ -34,11 +34,13 @@
 #include "utils/Timers.h"
 #include "utils/StopWatch.h"
 
+#include <sys/stat.h>
+
 using namespace android;
 using namespace android::renderscript;
 
 
-static Script * setTLS(Script *sc) {
+Script * rsdScriptSetTLS(Script *sc) {
     ScriptTLSStruct * tls = (ScriptTLSStruct *)pthread_getspecific(rsdgThreadTLSKey);
     rsAssert(tls);
     Script *old = tls->mScript;
@@ -46,6 +48,21 @@ static Script * setTLS(Script *sc) {
     return old;
 }
 
+// libbcc does not report the size of the loaded executable, so this is
+// only an estimate: the size of the object file the compiler driver
+// caches, or of the bitcode when that cannot be found.
+static size_t rsdScriptExecutableSize(const char *cacheDir, const char *resName,
+                                      size_t bitcodeSize) {
+    String8 path(cacheDir);
+    path.appendPath(resName);
+    path.append(".o");
+
+    struct stat st;
+    if (!stat(path.string(), &st)) {
+        return st.st_size;
+    }
+    return bitcodeSize;
+}
 
 bool rsdScriptInit(const Context *rsc,
                      ScriptC *script,
@@ -98,6 +115,8 @@ bool rsdScriptInit(const Context *rsc,
     }
 
     drv->mExecutable = exec;
+    drv->mExecutableSize = rsdScriptExecutableSize(cacheDir, resName, bitcodeSize);
+    rsc->trackMemory(RS_MEMORY_SCRIPT, drv->mExecutableSize);
 
     exec->setThreadable(script->mHal.info.isThreadable);
     if (!exec->syncInfo()) {
@@ -339,7 +358,7 @@ void rsdScriptLaunchThreads(const Context *rsc,
                             const RsScriptCall *sc,
                             MTLaunchStruct *mtls) {
 
-    Script * oldTLS = setTLS(s);
+    Script * oldTLS = rsdScriptSetTLS(s);
     Context *mrsc = (Context *)rsc;
     RsdHal * dc = (RsdHal *)mtls->rsc->mHal.drv;
 
@@ -409,7 +428,7 @@ void rsdScriptLaunchThreads(const Context *rsc,
         }
     }
 
-    setTLS(oldTLS);
+    rsdScriptSetTLS(oldTLS);
 }
 
 void rsdScriptInvokeForEach(const Context *rsc,
@@ -448,9 +467,9 @@ void rsdScriptInvokeForEach(const Context *rsc,
 int rsdScriptInvokeRoot(const Context *dc, Script *script) {
     DrvScript *drv = (DrvScript *)script->mHal.drv;
 
-    Script * oldTLS = setTLS(script);
+    Script * oldTLS = rsdScriptSetTLS(script);
     int ret = drv->mRoot();
-    setTLS(oldTLS);
+    rsdScriptSetTLS(oldTLS);
 
     return ret;
 }
@@ -478,10 +497,10 @@ void rsdScriptInvokeFunction(const Context *dc, Script *script,
     DrvScript *drv = (DrvScript *)script->mHal.drv;
     //ALOGE("invoke %p %p %i %p %i", dc, script, slot, params, paramLength);
 
-    Script * oldTLS = setTLS(script);
+    Script * oldTLS = rsdScriptSetTLS(script);
     reinterpret_cast<void (*)(const void *, uint32_t)>(
         drv->mExecutable->getExportFuncAddrs()[slot])(params, paramLength);
-    setTLS(oldTLS);
+    rsdScriptSetTLS(oldTLS);
 }
 
 void rsdScriptSetGlobalVar(const Context *dc, const Script *script,
@@ -527,20 +546,9 @@ void rsdScriptSetGlobalVarWithElemDims(
     // Only a single dimension is currently supported.
     rsAssert(dimLength == 1);
     if (dimLength == 1) {
-        // First do the increment loop.
-        size_t stride = elem->getSizeBytes();
-        char *cVal = reinterpret_cast<char *>(data);
-        for (size_t i = 0; i < dims[0]; i++) {
-            elem->incRefs(cVal);
-            cVal += stride;
-        }
-
-        // Decrement loop comes after (to prevent race conditions).
-        char *oldVal = reinterpret_cast<char *>(destPtr);
-        for (size_t i = 0; i < dims[0]; i++) {
-            elem->decRefs(oldVal);
-            oldVal += stride;
-        }
+        // Increment first, then decrement (to prevent race conditions).
+        elem->incRefs(data, dims[0]);
+        elem->decRefs(destPtr, dims[0]);
     }
 
     memcpy(destPtr, data, dataLength);
@@ -625,6 +633,9 @@ void rsdScriptDestroy(const Context *dc, Script *script) {
         }
     }
 
+    if (drv->mExecutableSize) {
+        dc->trackMemory(RS_MEMORY_SCRIPT, -(ssize_t)drv->mExecutableSize);
+    }
     delete drv->mCompilerContext;
     delete drv->mCompilerDriver;
     delete drv->mExecutable;
@@ -125,6 +125,7 @@ struct DrvScript {
     bcc::BCCContext *mCompilerContext;
     bcc::RSCompilerDriver *mCompilerDriver;
     bcc::RSExecutable *mExecutable;
+    size_t mExecutableSize;
 
     android::renderscript::Allocation **mBoundAllocs;
     RsdIntriniscFuncs_t mIntrinsicFuncs;
@@ -178,6 +179,9 @@ void rsdScriptInvokeForEachMtlsSetup(const android::renderscript::Context *rsc,
                                      const RsScriptCall *sc,
                                      MTLaunchStruct *mtls);
 
+// Sets the script seen by runtime calls from kernels, returns the old one.
+android::renderscript::Script * rsdScriptSetTLS(android::renderscript::Script *sc);
+
 
 
 
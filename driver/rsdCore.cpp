@@ -16,6 +16,7 @@
 
 #include "rsdCore.h"
 #include "rsdAllocation.h"
+#include "rsdAllocationPool.h"
 #include "rsdBcc.h"
 #include "rsdGL.h"
 #include "rsdPath.h"
@@ -43,6 +44,8 @@ using namespace android::renderscript;
 
 static void Shutdown(Context *rsc);
 static void SetPriority(const Context *rsc, int32_t priority);
+static void AttachThread(const Context *rsc);
+static void Dump(const Context *rsc);
 
 static RsdHalFunctions FunctionTable = {
     rsdGLInit,
@@ -53,6 +56,8 @@ static RsdHalFunctions FunctionTable = {
     Shutdown,
     NULL,
     SetPriority,
+    AttachThread,
+    Dump,
     {
         rsdScriptInit,
         rsdInitIntrinsic,
@@ -91,7 +96,11 @@ static RsdHalFunctions FunctionTable = {
         rsdAllocationData3D_alloc,
         rsdAllocationElementData1D,
         rsdAllocationElementData2D,
-        rsdAllocationGenerateMipmaps
+        rsdAllocationGenerateMipmaps,
+        rsdAllocationSetPoolLimit,
+        rsdAllocationTrimPool,
+        rsdAllocationInitFromFile,
+        rsdAllocationInitSnapshot
     },
 
 
@@ -233,6 +242,21 @@ extern "C" bool rsdHalInit(RsContext c, uint32_t version_major,
     }
     rsc->mHal.drv = dc;
 
+    dc->mAllocAlign = RSD_ALLOCATION_ALIGN;
+    if (rsc->props.mDebugAllocAlign) {
+        uint32_t align = rsc->props.mDebugAllocAlign;
+        if (align & (align - 1)) {
+            ALOGW("Ignoring debug.rs.alloc.align %u, not a power of two", align);
+        } else {
+            dc->mAllocAlign = align;
+        }
+    }
+    dc->mAllocMapThreshold = RSD_ALLOCATION_MMAP_THRESHOLD;
+    if (rsc->props.mDebugAllocMapThreshold) {
+        dc->mAllocMapThreshold = rsc->props.mDebugAllocMapThreshold;
+    }
+    dc->mAllocPool = new RsdAllocationPool(rsc, dc->mAllocAlign, RSD_ALLOCATION_POOL_LIMIT);
+
     pthread_mutex_lock(&rsdgInitMutex);
     if (!rsdgThreadTLSKeyCount) {
         int status = pthread_key_create(&rsdgThreadTLSKey, NULL);
@@ -309,6 +333,21 @@ void SetPriority(const Context *rsc, int32_t priority) {
     }
 }
 
+void AttachThread(const Context *rsc) {
+    RsdHal *dc = (RsdHal *)rsc->mHal.drv;
+    int status = pthread_setspecific(rsdgThreadTLSKey, &dc->mTlsStruct);
+    if (status) {
+        ALOGE("pthread_setspecific %i", status);
+    }
+}
+
+void Dump(const Context *rsc) {
+    RsdHal *dc = (RsdHal *)rsc->mHal.drv;
+    if (dc->mAllocPool) {
+        dc->mAllocPool->dumpStats();
+    }
+}
+
 void Shutdown(Context *rsc) {
     RsdHal *dc = (RsdHal *)rsc->mHal.drv;
 
@@ -325,6 +364,10 @@ void Shutdown(Context *rsc) {
     }
     rsAssert(android_atomic_acquire_load(&dc->mWorkers.mRunningCount) == 0);
 
+    // Allocations released after this point go straight to free.
+    delete dc->mAllocPool;
+    dc->mAllocPool = NULL;
+
     // Global structure cleanup.
     pthread_mutex_lock(&rsdgInitMutex);
     --rsdgThreadTLSKeyCount;
@@ -24,6 +24,8 @@
 
 #include "rsdGL.h"
 
+class RsdAllocationPool;
+
 typedef void (* InvokeFunc_t)(void);
 typedef void (* ForEachFunc_t)(void);
 typedef void (*WorkerCallback_t)(void *usr, uint32_t idx);
@@ -45,6 +47,11 @@ typedef struct RsdHalRec {
     bool mHasGraphics;
     bool mInForEach;
 
+    // Alignment of allocation storage and of padded 2D rows.
+    uint32_t mAllocAlign;
+    size_t mAllocMapThreshold;
+    RsdAllocationPool *mAllocPool;
+
     struct Workers {
         volatile int mRunningCount;
         volatile int mLaunchCount;
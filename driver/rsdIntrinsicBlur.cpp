@@ -31,6 +31,10 @@ struct ConvolveParams {
     int iradius;
     void **scratch;
     size_t *scratchSize;
+    // Set while rows are being dropped for lack of scratch, so the client
+    // is told once rather than once per row.
+    volatile int32_t scratchFailed;
+    const Context *rsc;
     ObjectBaseRef<Allocation> alloc;
 };
 
@@ -180,7 +184,18 @@ static void Blur_uchar4(const RsForEachStubParamStruct *p,
 
     if (p->dimX > 2048) {
         if ((p->dimX > cp->scratchSize[p->lid]) || !cp->scratch[p->lid]) {
-            cp->scratch[p->lid] = realloc(cp->scratch[p->lid], p->dimX * 16);
+            void *scratch = realloc(cp->scratch[p->lid], p->dimX * 16);
+            if (!scratch) {
+                if (!android_atomic_release_cas(0, 1, &cp->scratchFailed)) {
+                    cp->rsc->setError(RS_ERROR_OUT_OF_MEMORY,
+                                      "Blur scratch allocation failed, rows were not written");
+                }
+                return;
+            }
+            android_atomic_release_store(0, &cp->scratchFailed);
+            cp->rsc->trackMemory(RS_MEMORY_DRIVER_SCRATCH,
+                                 (ssize_t)(p->dimX - cp->scratchSize[p->lid]) * 16);
+            cp->scratch[p->lid] = scratch;
             cp->scratchSize[p->lid] = p->dimX;
         }
         buf = (float *)cp->scratch[p->lid];
@@ -242,6 +257,8 @@ static void Destroy(const Context *rsc, const Script *script, void * intrinsicDa
             for (size_t i = 0; i < dc->mWorkers.mCount + 1; i++) {
                 if (cp->scratch[i]) {
                     free(cp->scratch[i]);
+                    rsc->trackMemory(RS_MEMORY_DRIVER_SCRATCH,
+                                     -(ssize_t)(cp->scratchSize[i] * 16));
                 }
             }
             free(cp->scratch);
@@ -271,6 +288,7 @@ void * rsdIntrinsic_InitBlur(const android::renderscript::Context *rsc,
     }
 
     cp->radius = 5;
+    cp->rsc = rsc;
     cp->scratch = (void **)calloc(dc->mWorkers.mCount + 1, sizeof(void *));
     cp->scratchSize = (size_t *)calloc(dc->mWorkers.mCount + 1, sizeof(size_t));
     if (!cp->scratch || !cp->scratchSize) {
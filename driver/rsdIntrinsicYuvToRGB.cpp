@@ -93,9 +93,12 @@ static void YuvToRGB_uchar4(const RsForEachStubParamStruct *p,
     DrvAllocation *din = (DrvAllocation *)cp->alloc->mHal.drv;
     const uchar *pin = (const uchar *)din->lod[0].mallocPtr;
 
-    const uchar *Y = pin + (p->y * p->dimX);
-    const uchar *uv = pin + (p->dimX * p->dimY);
-    uv += (p->y>>1) * p->dimX;
+    // A 2D input may have padded rows.
+    size_t stride = din->lod[0].dimY ? din->lod[0].stride : p->dimX;
+
+    const uchar *Y = pin + (p->y * stride);
+    const uchar *uv = pin + (stride * p->dimY);
+    uv += (p->y>>1) * stride;
 
     uchar4 *out = (uchar4 *)p->out;
     uint32_t x1 = xstart;
@@ -25,45 +25,444 @@
 #include "rsScriptGroup.h"
 #include "rsdScriptGroup.h"
 #include "rsdBcc.h"
+#include "rsdAllocation.h"
 
 using namespace android;
 using namespace android::renderscript;
 
 
-bool rsdScriptGroupInit(const android::renderscript::Context *rsc,
-                        const android::renderscript::ScriptGroup *sg) {
+// Longest chain of kernels executed together, and the bytes of scratch
+// each worker keeps per intermediate for one tile of a row.
+#define RSD_SG_FUSE_MAX 8
+#define RSD_SG_FUSE_SCRATCH (8 * 1024)
+
+// A chain of point-wise kernels run one row tile at a time, so the
+// intermediates stay in the worker's scratch instead of going to memory.
+typedef struct {
+    MTLaunchStruct stage[RSD_SG_FUSE_MAX];
+    uint32_t count;
+
+    uint32_t xStart;
+    uint32_t xEnd;
+    uint32_t yStart;
+    uint32_t tile;
+    uint32_t tilesPerRow;
+    uint32_t unitCount;
+
+    uint32_t mSliceSize;
+    volatile int mSliceNum;
+} FusedLaunchStruct;
+
+static void rsdScriptGroupSetupLaunch(const Context *rsc, const ScriptKernelID *k,
+                                      Allocation *ain, Allocation *aout,
+                                      MTLaunchStruct *mtls) {
+    Script *s = k->mScript;
+    DrvScript *drv = (DrvScript *)s->mHal.drv;
+    uint32_t slot = k->mSlot;
+
+    rsdScriptInvokeForEachMtlsSetup(rsc, ain, aout, NULL, 0, NULL, mtls);
+    mtls->script = s;
+    mtls->fep.slot = slot;
+
+    if (drv->mIntrinsicID) {
+        mtls->kernel = (void (*)())drv->mIntrinsicFuncs.root;
+        mtls->fep.usr = drv->mIntrinsicData;
+    } else {
+        mtls->kernel = reinterpret_cast<ForEachFunc_t>(
+                          drv->mExecutable->getExportForeachFuncAddrs()[slot]);
+        rsAssert(mtls->kernel != NULL);
+        mtls->sig = drv->mExecutable->getInfo().getExportForeachFuncs()[slot].second;
+    }
+}
+
+static bool rsdScriptGroupIsIntrinsic(const ScriptKernelID *k) {
+    return ((DrvScript *)k->mScript->mHal.drv)->mIntrinsicID != 0;
+}
+
+// Intrinsics other than these work on whole rows, Blur for one keeps its
+// vertical pass for the row in scratch indexed from the row start.
+static bool rsdScriptGroupIsPointwise(const ScriptKernelID *k) {
+    switch (((DrvScript *)k->mScript->mHal.drv)->mIntrinsicID) {
+    case RS_SCRIPT_INTRINSIC_ID_UNDEFINED:
+    case RS_SCRIPT_INTRINSIC_ID_COLOR_MATRIX:
+    case RS_SCRIPT_INTRINSIC_ID_LUT:
+    case RS_SCRIPT_INTRINSIC_ID_BLEND:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// A chain with a whole row kernel can only run a row at a time, so each
+// intermediate row has to fit in scratch.
+static bool rsdScriptGroupChainFits(const ScriptKernelID * const *kernels,
+                                    Allocation * const *outs, size_t count) {
+    bool rows = false;
+    for (size_t ct=0; ct < count; ct++) {
+        rows |= !rsdScriptGroupIsPointwise(kernels[ct]);
+    }
+    if (!rows) {
+        return true;
+    }
+    for (size_t ct=0; (ct + 1) < count; ct++) {
+        const Type *t = outs[ct]->getType();
+        if (((size_t)t->getDimX() * t->getElementSizeBytes()) > RSD_SG_FUSE_SCRATCH) {
+            return false;
+        }
+    }
     return true;
 }
 
-void rsdScriptGroupSetInput(const android::renderscript::Context *rsc,
-                            const android::renderscript::ScriptGroup *sg,
-                            const android::renderscript::ScriptKernelID *kid,
-                            android::renderscript::Allocation *) {
+static bool rsdScriptGroupSameShape(const Allocation *a, const Allocation *b) {
+    const Type *ta = a->getType();
+    const Type *tb = b->getType();
+    return (ta->getDimX() == tb->getDimX()) && (ta->getDimY() == tb->getDimY()) &&
+           !ta->getDimZ() && !tb->getDimZ();
 }
 
-void rsdScriptGroupSetOutput(const android::renderscript::Context *rsc,
-                             const android::renderscript::ScriptGroup *sg,
-                             const android::renderscript::ScriptKernelID *kid,
-                             android::renderscript::Allocation *) {
+// src writing aout can be fused with dst reading ain if aout is an internal
+// link that only feeds dst's input, every stage covers the same cells and
+// at most one script in the chain depends on the runtime's script TLS.
+static bool rsdScriptGroupCanFuse(const ScriptGroup *sg,
+                                  const ScriptKernelID *src, const Allocation *aout,
+                                  const ScriptKernelID *dst, const Allocation *ain,
+                                  const Allocation *dstOut, const Allocation *shape,
+                                  Script **chainScript) {
+    if (!aout || (aout != ain) || !shape) {
+        return false;
+    }
+
+    size_t links = 0;
+    for (size_t ct=0; ct < sg->mLinks.size(); ct++) {
+        const ScriptGroup::Link *l = sg->mLinks[ct];
+        if (l->mSource.get() != src) {
+            continue;
+        }
+        if ((l->mDstKernel.get() != dst) || l->mDstField.get() || (l->mAlloc.get() != aout)) {
+            return false;
+        }
+        links++;
+    }
+    if (links != 1) {
+        return false;
+    }
+
+    if (!rsdScriptGroupSameShape(aout, shape) ||
+        (dstOut && !rsdScriptGroupSameShape(dstOut, shape)) ||
+        (aout->getType()->getElementSizeBytes() > RSD_SG_FUSE_SCRATCH)) {
+        return false;
+    }
+
+    if (!src->mScript->mHal.info.isThreadable || !dst->mScript->mHal.info.isThreadable) {
+        return false;
+    }
+
+    // Blend reads its output, which is scratch inside a chain.
+    DrvScript *srcDrv = (DrvScript *)src->mScript->mHal.drv;
+    DrvScript *dstDrv = (DrvScript *)dst->mScript->mHal.drv;
+    if ((srcDrv->mIntrinsicID == RS_SCRIPT_INTRINSIC_ID_BLEND) ||
+        (dstDrv->mIntrinsicID == RS_SCRIPT_INTRINSIC_ID_BLEND)) {
+        return false;
+    }
+
+    if (!dstDrv->mIntrinsicID) {
+        if (*chainScript && (*chainScript != dst->mScript)) {
+            return false;
+        }
+        *chainScript = dst->mScript;
+    }
+    return true;
 }
 
-void rsdScriptGroupExecute(const android::renderscript::Context *rsc,
-                           const android::renderscript::ScriptGroup *sg) {
+static void rsdScriptGroupInitParams(const FusedLaunchStruct *fl,
+                                     RsForEachStubParamStruct *p, uint32_t idx) {
+    for (uint32_t s = 0; s < fl->count; s++) {
+        memcpy(&p[s], &fl->stage[s].fep, sizeof(p[s]));
+        p[s].lid = idx;
+    }
+}
+
+// Runs work units [uStart, uEnd), each a row tile through every stage.
+static void rsdScriptGroupRunUnits(const FusedLaunchStruct *fl, RsForEachStubParamStruct *p,
+                                   uint8_t (*scratch)[RSD_SG_FUSE_SCRATCH],
+                                   uint32_t uStart, uint32_t uEnd) {
+    const MTLaunchStruct *first = &fl->stage[0];
+    const MTLaunchStruct *last = &fl->stage[fl->count - 1];
+    for (uint32_t u = uStart; u < uEnd; u++) {
+        uint32_t y = fl->yStart + u / fl->tilesPerRow;
+        uint32_t x1 = fl->xStart + (u % fl->tilesPerRow) * fl->tile;
+        uint32_t x2 = rsMin(x1 + fl->tile, fl->xEnd);
+
+        for (uint32_t s = 0; s < fl->count; s++) {
+            const MTLaunchStruct *m = &fl->stage[s];
+            p[s].y = y;
+            if (s) {
+                p[s].in = scratch[(s - 1) & 1];
+            } else {
+                p[s].in = first->fep.ptrIn + (first->fep.yStrideIn * y) +
+                          (first->fep.eStrideIn * x1);
+            }
+            if (m != last) {
+                p[s].out = scratch[s & 1];
+            } else {
+                p[s].out = last->fep.ptrOut + (last->fep.yStrideOut * y) +
+                           (last->fep.eStrideOut * x1);
+            }
+            ((outer_foreach_t)m->kernel)(&p[s], x1, x2, m->fep.eStrideIn, m->fep.eStrideOut);
+        }
+    }
+}
+
+static void wc_fused(void *usr, uint32_t idx) {
+    FusedLaunchStruct *fl = (FusedLaunchStruct *)usr;
+    RsForEachStubParamStruct p[RSD_SG_FUSE_MAX];
+    uint8_t scratch[2][RSD_SG_FUSE_SCRATCH] __attribute__((aligned(16)));
+
+    rsdScriptGroupInitParams(fl, p, idx);
+    while (1) {
+        uint32_t slice = (uint32_t)android_atomic_inc(&fl->mSliceNum);
+        uint32_t uStart = slice * fl->mSliceSize;
+        uint32_t uEnd = rsMin(uStart + fl->mSliceSize, fl->unitCount);
+        if (uEnd <= uStart) {
+            return;
+        }
+        rsdScriptGroupRunUnits(fl, p, scratch, uStart, uEnd);
+    }
+}
+
+// Fills fl for the count kernels starting at kernels, splitting the work
+// for the given number of workers.  serial keeps it to one slice.
+static void rsdScriptGroupSetupFused(const Context *rsc, const ScriptKernelID * const *kernels,
+                                     Allocation * const *ins, Allocation * const *outs,
+                                     size_t count, uint32_t workers, bool serial,
+                                     FusedLaunchStruct *fl) {
+    fl->count = count;
+
+    uint32_t maxStride = 1;
+    bool rows = false;
+    for (size_t ct=0; ct < count; ct++) {
+        rsdScriptGroupSetupLaunch(rsc, kernels[ct], ins[ct], outs[ct], &fl->stage[ct]);
+        if ((ct + 1) < count) {
+            maxStride = rsMax(maxStride, fl->stage[ct].fep.eStrideOut);
+        }
+        rows |= !rsdScriptGroupIsPointwise(kernels[ct]);
+    }
+
+    const MTLaunchStruct *first = &fl->stage[0];
+    fl->xStart = first->xStart;
+    fl->xEnd = first->xEnd;
+    fl->yStart = first->yStart;
+    fl->tile = RSD_SG_FUSE_SCRATCH / maxStride;
+    if (rows) {
+        fl->tile = rsMax(1u, fl->xEnd - fl->xStart);
+    }
+    fl->tilesPerRow = (fl->xEnd - fl->xStart + fl->tile - 1) / fl->tile;
+    fl->unitCount = fl->tilesPerRow * (first->yEnd - first->yStart);
+    fl->mSliceNum = 0;
+    if (serial) {
+        fl->mSliceSize = fl->unitCount;
+    } else {
+        fl->mSliceSize = rsMax(1u, fl->unitCount / ((workers + 1) * 4));
+    }
+}
+
+static void rsdScriptGroupLaunchFused(const Context *rsc, FusedLaunchStruct *fl, Script *s) {
+    RsdHal * dc = (RsdHal *)rsc->mHal.drv;
+    fl->mSliceNum = 0;
+
+    Script *oldTLS = rsdScriptSetTLS(s);
+    if ((dc->mWorkers.mCount >= 1) && !dc->mInForEach) {
+        dc->mInForEach = true;
+        rsdLaunchThreads((Context *)rsc, wc_fused, fl);
+        dc->mInForEach = false;
+    } else {
+        wc_fused(fl, 0);
+    }
+    rsdScriptSetTLS(oldTLS);
+}
+
+// Most launches run in one pass of the worker pool.
+#define RSD_SG_WAVE_MAX 16
+
+// Independent launches sharing the worker pool, each worker takes slices
+// of whichever launch has work left.
+typedef struct {
+    FusedLaunchStruct *launch[RSD_SG_WAVE_MAX];
+    // Running total of slices up to and including each launch.
+    uint32_t sliceEnd[RSD_SG_WAVE_MAX];
+    uint32_t count;
+    volatile int mSliceNum;
+} WaveLaunchStruct;
 
-    Vector<Allocation *> ins;
-    Vector<Allocation *> outs;
-    Vector<const ScriptKernelID *> kernels;
+static void wc_wave(void *usr, uint32_t idx) {
+    WaveLaunchStruct *wl = (WaveLaunchStruct *)usr;
+    RsForEachStubParamStruct p[RSD_SG_FUSE_MAX];
+    uint8_t scratch[2][RSD_SG_FUSE_SCRATCH] __attribute__((aligned(16)));
+
+    uint32_t current = wl->count;
+    uint32_t t = 0;
+    while (1) {
+        uint32_t slice = (uint32_t)android_atomic_inc(&wl->mSliceNum);
+        while ((t < wl->count) && (slice >= wl->sliceEnd[t])) {
+            t++;
+        }
+        if (t >= wl->count) {
+            return;
+        }
+
+        const FusedLaunchStruct *fl = wl->launch[t];
+        if (t != current) {
+            rsdScriptGroupInitParams(fl, p, idx);
+            current = t;
+        }
+        uint32_t local = slice - (t ? wl->sliceEnd[t - 1] : 0);
+        uint32_t uStart = local * fl->mSliceSize;
+        uint32_t uEnd = rsMin(uStart + fl->mSliceSize, fl->unitCount);
+        rsdScriptGroupRunUnits(fl, p, scratch, uStart, uEnd);
+    }
+}
+
+// A launch of the group, a single kernel or a fused chain of them.
+typedef struct {
+    size_t first;
+    size_t count;
+    // The one script in the launch that is not an intrinsic, if any.
+    Script *script;
+    uint32_t wave;
+    // Threadable and without 3D allocations, so it can share the pool
+    // with other launches.
+    bool shareable;
+    FusedLaunchStruct *launch;
+} SGLaunchTask;
+
+// What execute runs, worked out at init and again whenever an input or
+// output of the group changes.
+struct DrvScriptGroup {
+    Vector<Allocation *> mIns;
+    Vector<Allocation *> mOuts;
+    Vector<const ScriptKernelID *> mKernels;
+
+    // Bound to their scripts before each run.
+    Vector<const ScriptGroup::Link *> mFieldLinks;
+
+    // In wave order, each with its launch state ready in mLaunches.
+    Vector<SGLaunchTask> mTasks;
+    FusedLaunchStruct *mLaunches;
+
+    // Buffer and type of every in and out when planned.  Resizing or
+    // receiving a new buffer changes them and leaves the plan stale.
+    Vector<const void *> mPtrs;
+    Vector<const Type *> mTypes;
+};
+
+static bool rsdScriptGroupTaskReads(const DrvScriptGroup *dsg, const SGLaunchTask *t,
+                                    const Allocation *a) {
+    if (dsg->mIns[t->first] == a) {
+        return true;
+    }
+    for (size_t ct=0; ct < dsg->mFieldLinks.size(); ct++) {
+        const ScriptGroup::Link *l = dsg->mFieldLinks[ct];
+        if (l->mAlloc.get() != a) {
+            continue;
+        }
+        for (size_t ct2=0; ct2 < t->count; ct2++) {
+            if (l->mDstField->mScript == dsg->mKernels[t->first + ct2]->mScript) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Whether b has to wait for a, which comes first in the sequential order:
+// one reads or writes what the other writes, they share a script and so
+// its globals, or both need the runtime's script TLS.
+static bool rsdScriptGroupTaskDepends(const DrvScriptGroup *dsg,
+                                      const SGLaunchTask *a, const SGLaunchTask *b) {
+    if (a->script && b->script) {
+        return true;
+    }
+    for (size_t ct=0; ct < a->count; ct++) {
+        for (size_t ct2=0; ct2 < b->count; ct2++) {
+            if (dsg->mKernels[a->first + ct]->mScript == dsg->mKernels[b->first + ct2]->mScript) {
+                return true;
+            }
+        }
+    }
+
+    const Allocation *wa = dsg->mOuts[a->first + a->count - 1];
+    const Allocation *wb = dsg->mOuts[b->first + b->count - 1];
+    if (wa && ((wa == wb) || rsdScriptGroupTaskReads(dsg, b, wa))) {
+        return true;
+    }
+    if (wb && rsdScriptGroupTaskReads(dsg, a, wb)) {
+        return true;
+    }
+    return false;
+}
+
+static bool rsdScriptGroupTaskIsShareable(const DrvScriptGroup *dsg, const SGLaunchTask *t) {
+    for (size_t ct=0; ct < t->count; ct++) {
+        const Allocation *ain = dsg->mIns[t->first + ct];
+        const Allocation *aout = dsg->mOuts[t->first + ct];
+        if ((ain && ain->getType()->getDimZ()) || (aout && aout->getType()->getDimZ())) {
+            return false;
+        }
+        if (!dsg->mKernels[t->first + ct]->mScript->mHal.info.isThreadable) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void rsdScriptGroupSnapshot(const Allocation *a, const void **ptr, const Type **type) {
+    if (a) {
+        *ptr = ((const DrvAllocation *)a->mHal.drv)->lod[0].mallocPtr;
+        *type = a->getType();
+    } else {
+        *ptr = NULL;
+        *type = NULL;
+    }
+}
+
+static bool rsdScriptGroupPlanIsStale(const DrvScriptGroup *dsg) {
+    for (size_t ct=0; ct < dsg->mIns.size(); ct++) {
+        const void *ptr;
+        const Type *type;
+        rsdScriptGroupSnapshot(dsg->mIns[ct], &ptr, &type);
+        if ((ptr != dsg->mPtrs[ct * 2]) || (type != dsg->mTypes[ct * 2])) {
+            return true;
+        }
+        rsdScriptGroupSnapshot(dsg->mOuts[ct], &ptr, &type);
+        if ((ptr != dsg->mPtrs[ct * 2 + 1]) || (type != dsg->mTypes[ct * 2 + 1])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool rsdScriptGroupBuildPlan(const Context *rsc, const ScriptGroup *sg,
+                                    DrvScriptGroup *dsg) {
+    RsdHal * dc = (RsdHal *)rsc->mHal.drv;
+
+    dsg->mIns.clear();
+    dsg->mOuts.clear();
+    dsg->mKernels.clear();
+    dsg->mFieldLinks.clear();
+    dsg->mTasks.clear();
+    dsg->mPtrs.clear();
+    dsg->mTypes.clear();
+    free(dsg->mLaunches);
+    dsg->mLaunches = NULL;
 
     for (size_t ct=0; ct < sg->mNodes.size(); ct++) {
         ScriptGroup::Node *n = sg->mNodes[ct];
-        Script *s = n->mKernels[0]->mScript;
 
         //ALOGE("node %i, order %i, in %i out %i", (int)ct, n->mOrder, (int)n->mInputs.size(), (int)n->mOutputs.size());
 
         for (size_t ct2=0; ct2 < n->mInputs.size(); ct2++) {
             if (n->mInputs[ct2]->mDstField.get() && n->mInputs[ct2]->mDstField->mScript) {
-                //ALOGE("field %p %zu", n->mInputs[ct2]->mDstField->mScript, n->mInputs[ct2]->mDstField->mSlot);
-                s->setVarObj(n->mInputs[ct2]->mDstField->mSlot, n->mInputs[ct2]->mAlloc.get());
+                dsg->mFieldLinks.add(n->mInputs[ct2]);
             }
         }
 
@@ -100,49 +499,232 @@ void rsdScriptGroupExecute(const android::renderscript::Context *rsc,
 
             if ((k->mHasKernelOutput == (aout != NULL)) &&
                 (k->mHasKernelInput == (ain != NULL))) {
-                ins.add(ain);
-                outs.add(aout);
-                kernels.add(k);
+                dsg->mIns.add(ain);
+                dsg->mOuts.add(aout);
+                dsg->mKernels.add(k);
+
+                const void *ptr;
+                const Type *type;
+                rsdScriptGroupSnapshot(ain, &ptr, &type);
+                dsg->mPtrs.add(ptr);
+                dsg->mTypes.add(type);
+                rsdScriptGroupSnapshot(aout, &ptr, &type);
+                dsg->mPtrs.add(ptr);
+                dsg->mTypes.add(type);
             }
         }
+    }
+
+    const Vector<Allocation *> &ins = dsg->mIns;
+    const Vector<Allocation *> &outs = dsg->mOuts;
+    const Vector<const ScriptKernelID *> &kernels = dsg->mKernels;
+
+    // Split the kernels into launches, fusing chains where possible.
+    Vector<SGLaunchTask> tasks;
+    for (size_t ct=0; ct < ins.size(); ct++) {
+        // Extend a chain while the next kernel only consumes this one's
+        // output through its input.
+        size_t count = 1;
+        Script *chainScript = rsdScriptGroupIsIntrinsic(kernels[ct]) ? NULL : kernels[ct]->mScript;
+        const Allocation *shape = ins[ct] ? ins[ct] : outs[ct];
+        while (!rsc->props.mDebugNoKernelFusion &&
+               ((ct + count) < ins.size()) && (count < RSD_SG_FUSE_MAX) &&
+               rsdScriptGroupCanFuse(sg, kernels[ct + count - 1], outs[ct + count - 1],
+                                     kernels[ct + count], ins[ct + count],
+                                     outs[ct + count], shape, &chainScript) &&
+               rsdScriptGroupChainFits(kernels.array() + ct, outs.array() + ct, count + 1)) {
+            count++;
+        }
 
+        SGLaunchTask t;
+        t.first = ct;
+        t.count = count;
+        t.script = chainScript;
+        t.wave = 0;
+        t.shareable = rsdScriptGroupTaskIsShareable(dsg, &t);
+        t.launch = NULL;
+        tasks.add(t);
+        ct += count - 1;
     }
 
+    // Each launch goes in the wave after the last one it depends on, the
+    // launches of a wave then run side by side.
+    uint32_t waveCount = 0;
+    for (size_t ct=0; ct < tasks.size(); ct++) {
+        SGLaunchTask &t = tasks.editItemAt(ct);
+        for (size_t ct2=0; ct2 < ct; ct2++) {
+            if ((tasks[ct2].wave >= t.wave) &&
+                rsdScriptGroupTaskDepends(dsg, &tasks[ct2], &t)) {
+                t.wave = tasks[ct2].wave + 1;
+            }
+        }
+        waveCount = rsMax(waveCount, t.wave + 1);
+    }
+    for (uint32_t w = 0; w < waveCount; w++) {
+        for (size_t ct=0; ct < tasks.size(); ct++) {
+            if (tasks[ct].wave == w) {
+                dsg->mTasks.add(tasks[ct]);
+            }
+        }
+    }
+
+    if (!dsg->mTasks.size()) {
+        return true;
+    }
+    dsg->mLaunches = (FusedLaunchStruct *)malloc(sizeof(FusedLaunchStruct) *
+                                                 dsg->mTasks.size());
+    if (!dsg->mLaunches) {
+        ALOGE("Unable to allocate the ScriptGroup plan");
+        dsg->mTasks.clear();
+        return false;
+    }
+    for (size_t ct=0; ct < dsg->mTasks.size(); ct++) {
+        SGLaunchTask &t = dsg->mTasks.editItemAt(ct);
+        bool serial = !kernels[t.first]->mScript->mHal.info.isThreadable;
+        t.launch = &dsg->mLaunches[ct];
+        rsdScriptGroupSetupFused(rsc, kernels.array() + t.first, ins.array() + t.first,
+                                 outs.array() + t.first, t.count, dc->mWorkers.mCount,
+                                 serial, t.launch);
+    }
+    return true;
+}
+
+static void rsdScriptGroupRunTask(const Context *rsc, const DrvScriptGroup *dsg,
+                                  const SGLaunchTask *t) {
+    const ScriptKernelID *k = dsg->mKernels[t->first];
+    if (t->count > 1) {
+        rsdScriptGroupLaunchFused(rsc, t->launch, t->script ? t->script : k->mScript);
+        return;
+    }
+
+    MTLaunchStruct *mtls = &t->launch->stage[0];
+    mtls->mSliceNum = 0;
+    rsdScriptLaunchThreads(rsc, k->mScript, k->mSlot, dsg->mIns[t->first],
+                           dsg->mOuts[t->first], NULL, 0, NULL, mtls);
+}
+
+// Runs up to RSD_SG_WAVE_MAX launches in one pass of the worker pool.
+static void rsdScriptGroupLaunchShared(const Context *rsc, const DrvScriptGroup *dsg,
+                                       const SGLaunchTask * const *tasks, uint32_t count) {
     RsdHal * dc = (RsdHal *)rsc->mHal.drv;
-    MTLaunchStruct mtls;
-    for (size_t ct=0; ct < ins.size(); ct++) {
+    if (count == 1) {
+        rsdScriptGroupRunTask(rsc, dsg, tasks[0]);
+        return;
+    }
+
+    WaveLaunchStruct wl;
+    wl.count = count;
+    wl.mSliceNum = 0;
 
-        Script *s = kernels[ct]->mScript;
-        DrvScript *drv = (DrvScript *)s->mHal.drv;
-        uint32_t slot = kernels[ct]->mSlot;
+    Script *tls = NULL;
+    uint32_t slices = 0;
+    for (uint32_t ct=0; ct < count; ct++) {
+        FusedLaunchStruct *fl = tasks[ct]->launch;
+        wl.launch[ct] = fl;
+        if (fl->unitCount) {
+            slices += (fl->unitCount + fl->mSliceSize - 1) / fl->mSliceSize;
+        }
+        wl.sliceEnd[ct] = slices;
+        if (tasks[ct]->script) {
+            tls = tasks[ct]->script;
+        }
+    }
 
-        rsdScriptInvokeForEachMtlsSetup(rsc, ins[ct], outs[ct], NULL, 0, NULL, &mtls);
-        mtls.script = s;
-        mtls.fep.slot = slot;
+    Script *oldTLS = rsdScriptSetTLS(tls ? tls : dsg->mKernels[tasks[0]->first]->mScript);
+    dc->mInForEach = true;
+    rsdLaunchThreads((Context *)rsc, wc_wave, &wl);
+    dc->mInForEach = false;
+    rsdScriptSetTLS(oldTLS);
+}
 
-        if (drv->mIntrinsicID) {
-            mtls.kernel = (void (*)())drv->mIntrinsicFuncs.root;
-            mtls.fep.usr = drv->mIntrinsicData;
-        } else {
-            mtls.kernel = reinterpret_cast<ForEachFunc_t>(
-                              drv->mExecutable->getExportForeachFuncAddrs()[slot]);
-            rsAssert(mtls.kernel != NULL);
-            mtls.sig = drv->mExecutable->getInfo().getExportForeachFuncs()[slot].second;
+// Runs launches that do not depend on each other, sharing the pool among
+// those that can.  The rest run here as they would outside a wave, since
+// non-threadable scripts expect the context thread.
+static void rsdScriptGroupRunWave(const Context *rsc, const DrvScriptGroup *dsg,
+                                  const SGLaunchTask *tasks, size_t count) {
+    RsdHal * dc = (RsdHal *)rsc->mHal.drv;
+    bool pool = (count > 1) && (dc->mWorkers.mCount >= 1) && !dc->mInForEach;
+
+    const SGLaunchTask *shared[RSD_SG_WAVE_MAX];
+    uint32_t sharedCount = 0;
+    for (size_t ct=0; ct < count; ct++) {
+        if (!pool || !tasks[ct].shareable) {
+            rsdScriptGroupRunTask(rsc, dsg, &tasks[ct]);
+            continue;
+        }
+        shared[sharedCount++] = &tasks[ct];
+        if (sharedCount == RSD_SG_WAVE_MAX) {
+            rsdScriptGroupLaunchShared(rsc, dsg, shared, sharedCount);
+            sharedCount = 0;
         }
+    }
+    if (sharedCount) {
+        rsdScriptGroupLaunchShared(rsc, dsg, shared, sharedCount);
+    }
+}
 
-//        typedef void (*outer_foreach_t)(
-  //          const android::renderscript::RsForEachStubParamStruct *,
-    //        uint32_t x1, uint32_t x2,
-      //      uint32_t instep, uint32_t outstep);
-        //outer_foreach_t fn = (outer_foreach_t) mtls->kernel;
+bool rsdScriptGroupInit(const android::renderscript::Context *rsc,
+                        const android::renderscript::ScriptGroup *sg) {
+    DrvScriptGroup *dsg = new DrvScriptGroup();
+    dsg->mLaunches = NULL;
+    ((ScriptGroup *)sg)->mHal.drv = dsg;
+    return rsdScriptGroupBuildPlan(rsc, sg, dsg);
+}
 
-        rsdScriptLaunchThreads(rsc, s, slot, ins[ct], outs[ct], NULL, 0, NULL, &mtls);
+void rsdScriptGroupSetInput(const android::renderscript::Context *rsc,
+                            const android::renderscript::ScriptGroup *sg,
+                            const android::renderscript::ScriptKernelID *kid,
+                            android::renderscript::Allocation *) {
+    DrvScriptGroup *dsg = (DrvScriptGroup *)sg->mHal.drv;
+    if (dsg) {
+        rsdScriptGroupBuildPlan(rsc, sg, dsg);
     }
+}
 
+void rsdScriptGroupSetOutput(const android::renderscript::Context *rsc,
+                             const android::renderscript::ScriptGroup *sg,
+                             const android::renderscript::ScriptKernelID *kid,
+                             android::renderscript::Allocation *) {
+    DrvScriptGroup *dsg = (DrvScriptGroup *)sg->mHal.drv;
+    if (dsg) {
+        rsdScriptGroupBuildPlan(rsc, sg, dsg);
+    }
 }
 
-void rsdScriptGroupDestroy(const android::renderscript::Context *rsc,
+void rsdScriptGroupExecute(const android::renderscript::Context *rsc,
                            const android::renderscript::ScriptGroup *sg) {
-}
+    DrvScriptGroup *dsg = (DrvScriptGroup *)sg->mHal.drv;
+    if (!dsg) {
+        return;
+    }
+    if (rsdScriptGroupPlanIsStale(dsg)) {
+        rsdScriptGroupBuildPlan(rsc, sg, dsg);
+    }
 
+    for (size_t ct=0; ct < dsg->mFieldLinks.size(); ct++) {
+        const ScriptGroup::Link *l = dsg->mFieldLinks[ct];
+        //ALOGE("field %p %zu", l->mDstField->mScript, l->mDstField->mSlot);
+        l->mDstField->mScript->setVarObj(l->mDstField->mSlot, l->mAlloc.get());
+    }
 
+    const SGLaunchTask *tasks = dsg->mTasks.array();
+    size_t ct = 0;
+    while (ct < dsg->mTasks.size()) {
+        size_t end = ct + 1;
+        while ((end < dsg->mTasks.size()) && (tasks[end].wave == tasks[ct].wave)) {
+            end++;
+        }
+        rsdScriptGroupRunWave(rsc, dsg, tasks + ct, end - ct);
+        ct = end;
+    }
+}
+
+void rsdScriptGroupDestroy(const android::renderscript::Context *rsc,
+                           const android::renderscript::ScriptGroup *sg) {
+    DrvScriptGroup *dsg = (DrvScriptGroup *)sg->mHal.drv;
+    if (dsg) {
+        free(dsg->mLaunches);
+        delete dsg;
+        ((ScriptGroup *)sg)->mHal.drv = NULL;
+    }
+}
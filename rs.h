@@ -52,6 +52,13 @@ RsDevice rsDeviceCreate();
 void rsDeviceDestroy(RsDevice dev);
 void rsDeviceSetConfig(RsDevice dev, RsDeviceParam p, int32_t value);
 RsContext rsContextCreate(RsDevice dev, uint32_t version, uint32_t sdkVersion);
+RsContext rsContextCreateWithFlags(RsDevice dev, uint32_t version, uint32_t sdkVersion,
+                                   uint32_t flags);
+// Records all API calls made on the context to path for replay by
+// rs-replay.  Also enabled for new compute contexts by setting the
+// debug.rs.capture property to a file prefix.
+bool rsContextStartCapture(RsContext, const char *path);
+void rsContextStopCapture(RsContext);
 RsContext rsContextCreateGL(RsDevice dev, uint32_t version, uint32_t sdkVersion,
                             RsSurfaceConfig sc, uint32_t dpi);
 
@@ -18,6 +18,14 @@ ContextPeekMessage {
     ret RsMessageToClientType
 }
 
+ContextGetMessages {
+    direct
+    param void *data
+    param size_t *receiveLen
+    param uint32_t *count
+    ret RsMessageToClientType
+}
+
 ContextInitToClient {
     direct
 }
@@ -42,7 +50,7 @@ AllocationCreateTyped {
     param RsType vtype
     param RsAllocationMipmapControl mips
     param uint32_t usages
-    param uint32_t ptr
+    param uintptr_t ptr
     ret RsAllocation
 }
 
@@ -64,6 +72,20 @@ AllocationCubeCreateFromBitmap {
     ret RsAllocation
 }
 
+AllocationCreateFromFile {
+    direct
+    param RsType vtype
+    param uint32_t usages
+    param int32_t fd
+    param size_t offset
+    ret RsAllocation
+}
+
+AllocationSnapshot {
+    param RsAllocation va
+    ret RsAllocation
+}
+
 AllocationGetSurfaceTextureID {
     param RsAllocation alloc
     ret int32_t
@@ -135,6 +157,28 @@ ContextDump {
     param int32_t bits
 }
 
+ContextGetMemoryUsage {
+    param void *usage
+    sync
+}
+
+ContextSetCommandStats {
+    param bool enable
+}
+
+ContextGetCommandStats {
+    param void *stats
+    ret uint32_t
+}
+
+ContextSetAllocationPoolLimit {
+    param size_t bytes
+}
+
+ContextTrimAllocationPool {
+    param size_t bytes
+}
+
 ContextSetPriority {
     param int32_t priority
     }
@@ -212,6 +256,18 @@ Allocation2DElementData {
     param size_t element_offset
     }
 
+Allocation3DData {
+    param RsAllocation va
+    param uint32_t xoff
+    param uint32_t yoff
+    param uint32_t zoff
+    param uint32_t lod
+    param uint32_t w
+    param uint32_t h
+    param uint32_t d
+    param const void *data
+    }
+
 AllocationGenerateMipmaps {
     param RsAllocation va
 }
@@ -221,6 +277,18 @@ AllocationRead {
     param void * data
     }
 
+Allocation3DRead {
+    param RsAllocation va
+    param uint32_t xoff
+    param uint32_t yoff
+    param uint32_t zoff
+    param uint32_t lod
+    param uint32_t w
+    param uint32_t h
+    param uint32_t d
+    param void *data
+    }
+
 AllocationSyncAll {
     param RsAllocation va
     param RsAllocationUsageType src
@@ -253,6 +321,22 @@ AllocationCopy2DRange {
     param uint32_t srcFace
     }
 
+AllocationCopy3DRange {
+    param RsAllocation dest
+    param uint32_t destXoff
+    param uint32_t destYoff
+    param uint32_t destZoff
+    param uint32_t destMip
+    param uint32_t width
+    param uint32_t height
+    param uint32_t depth
+    param RsAllocation src
+    param uint32_t srcXoff
+    param uint32_t srcYoff
+    param uint32_t srcZoff
+    param uint32_t srcMip
+    }
+
 SamplerCreate {
     direct
     param RsSamplerValue magFilter
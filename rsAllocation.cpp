@@ -18,6 +18,7 @@
 #include "rsAllocation.h"
 #include "rsAdapter.h"
 #include "rs_hal.h"
+#include "rsCapture.h"
 
 #include "system/window.h"
 #include "gui/SurfaceTexture.h"
@@ -30,17 +31,49 @@ Allocation::Allocation(Context *rsc, const Type *type, uint32_t usages,
     : ObjectBase(rsc) {
 
     memset(&mHal, 0, sizeof(mHal));
+    mMemoryCategory = RS_MEMORY_ALLOCATION;
     mHal.state.mipmapControl = RS_ALLOCATION_MIPMAP_NONE;
     mHal.state.usageFlags = usages;
     mHal.state.mipmapControl = mc;
+    if (usages & RS_ALLOCATION_USAGE_SHARED) {
+        mHal.state.userProvidedPtr = ptr;
+    }
 
     setType(type);
     updateCache();
 }
 
 Allocation * Allocation::createAllocation(Context *rsc, const Type *type, uint32_t usages,
-                              RsAllocationMipmapControl mc, void * ptr) {
-    Allocation *a = new Allocation(rsc, type, usages, mc, ptr);
+                              RsAllocationMipmapControl mc, void * ptr,
+                              RsMemoryCategory category) {
+    if (usages & RS_ALLOCATION_USAGE_SHARED) {
+        if (!ptr || (usages & ~(RS_ALLOCATION_USAGE_SCRIPT | RS_ALLOCATION_USAGE_SHARED))) {
+            rsc->setError(RS_ERROR_BAD_VALUE, "Shared allocations need memory and script usage only");
+            return NULL;
+        }
+        if (type->getElement()->getHasReferences()) {
+            rsc->setError(RS_ERROR_BAD_VALUE, "Shared allocations cannot hold objects");
+            return NULL;
+        }
+        // Natural alignment of the element, up to 16 bytes.
+        size_t align = 1;
+        while ((align < type->getElementSizeBytes()) && (align < 16)) {
+            align <<= 1;
+        }
+        if ((uintptr_t)ptr & (align - 1)) {
+            rsc->setError(RS_ERROR_BAD_VALUE, "Shared allocation memory is misaligned");
+            return NULL;
+        }
+    } else if (ptr) {
+        ALOGW("Allocation memory ignored without RS_ALLOCATION_USAGE_SHARED");
+    }
+
+    Allocation *a = new (rsc) Allocation(rsc, type, usages, mc, ptr);
+    if (!a) {
+        rsc->setError(RS_ERROR_OUT_OF_MEMORY, "Allocation object allocation failed");
+        return NULL;
+    }
+    a->mMemoryCategory = category;
 
     if (!rsc->mHal.funcs.allocation.init(rsc, a, type->getElement()->getHasReferences())) {
         rsc->setError(RS_ERROR_FATAL_DRIVER, "Allocation::Allocation, alloc failure");
@@ -51,6 +84,75 @@ Allocation * Allocation::createAllocation(Context *rsc, const Type *type, uint32
     return a;
 }
 
+Allocation * Allocation::createFromFile(Context *rsc, const Type *type, uint32_t usages,
+                                        int fd, size_t offset) {
+    if (type->getElement()->getHasReferences()) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "Cannot map a file as an allocation of objects");
+        return NULL;
+    }
+    if (usages & (RS_ALLOCATION_USAGE_IO_INPUT | RS_ALLOCATION_USAGE_IO_OUTPUT)) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "Cannot map a file as an IO allocation");
+        return NULL;
+    }
+    // The mapping starts on a page boundary, so the data is only as aligned
+    // as the offset is.
+    size_t eSize = type->getElement()->getSizeBytes();
+    size_t align = eSize & -eSize;
+    if (align > 16) {
+        align = 16;
+    }
+    if (offset & (align - 1)) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "File offset is not aligned to the element size");
+        return NULL;
+    }
+
+    Allocation *a = new (rsc) Allocation(rsc, type, usages, RS_ALLOCATION_MIPMAP_NONE, NULL);
+    if (!a) {
+        rsc->setError(RS_ERROR_OUT_OF_MEMORY, "Allocation object allocation failed");
+        return NULL;
+    }
+
+    if (!rsc->mHal.funcs.allocation.initFromFile(rsc, a, fd, offset)) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "Allocation::createFromFile, map failure");
+        delete a;
+        return NULL;
+    }
+
+    return a;
+}
+
+Allocation * Allocation::createSnapshot(Context *rsc, const Allocation *src) {
+    if (src->mHal.state.hasReferences) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "Cannot snapshot an allocation of objects");
+        return NULL;
+    }
+
+    uint32_t usages = src->mHal.state.usageFlags &
+        ~(RS_ALLOCATION_USAGE_SHARED | RS_ALLOCATION_USAGE_IO_INPUT | RS_ALLOCATION_USAGE_IO_OUTPUT);
+    Allocation *a = new (rsc) Allocation(rsc, src->mHal.state.type, usages | RS_ALLOCATION_USAGE_SCRIPT,
+                                   src->mHal.state.mipmapControl, NULL);
+    if (!a) {
+        rsc->setError(RS_ERROR_OUT_OF_MEMORY, "Allocation object allocation failed");
+        return NULL;
+    }
+
+    if (!rsc->mHal.funcs.allocation.initSnapshot(rsc, a, src)) {
+        rsc->setError(RS_ERROR_FATAL_DRIVER, "Allocation::createSnapshot, alloc failure");
+        delete a;
+        return NULL;
+    }
+
+    return a;
+}
+
+void * Allocation::operator new(size_t size, Context *rsc) throw() {
+    return rsc->mSlabs.alloc(size);
+}
+
+void Allocation::operator delete(void *ptr) {
+    SlabHeap::free(ptr);
+}
+
 void Allocation::updateCache() {
     const Type *type = mHal.state.type;
     mHal.state.dimensionX = type->getDimX();
@@ -108,6 +210,21 @@ void Allocation::data(Context *rsc, uint32_t xoff, uint32_t yoff, uint32_t lod,
 void Allocation::data(Context *rsc, uint32_t xoff, uint32_t yoff, uint32_t zoff,
                       uint32_t lod, RsAllocationCubemapFace face,
                       uint32_t w, uint32_t h, uint32_t d, const void *data, size_t sizeBytes) {
+    const size_t eSize = mHal.state.elementSizeBytes;
+    const size_t lineSize = eSize * w;
+
+    if ((lineSize * h * d) != sizeBytes) {
+        ALOGE("Allocation size mismatch, expected %zu, got %zu", (lineSize * h * d), sizeBytes);
+        rsAssert(!"Allocation::subData called with mismatched size");
+        return;
+    }
+    if (!checkRange3D(xoff, yoff, zoff, lod, w, h, d)) {
+        ALOGE("Allocation::subData 3D range out of bounds");
+        return;
+    }
+
+    rsc->mHal.funcs.allocation.data3D(rsc, this, xoff, yoff, zoff, lod, face, w, h, d, data, sizeBytes);
+    sendDirty(rsc);
 }
 
 void Allocation::read(Context *rsc, uint32_t xoff, uint32_t lod,
@@ -141,6 +258,34 @@ void Allocation::read(Context *rsc, uint32_t xoff, uint32_t yoff, uint32_t lod,
 void Allocation::read(Context *rsc, uint32_t xoff, uint32_t yoff, uint32_t zoff,
                       uint32_t lod, RsAllocationCubemapFace face,
                       uint32_t w, uint32_t h, uint32_t d, void *data, size_t sizeBytes) {
+    const size_t eSize = mHal.state.elementSizeBytes;
+    const size_t lineSize = eSize * w;
+
+    if ((lineSize * h * d) != sizeBytes) {
+        ALOGE("Allocation size mismatch, expected %zu, got %zu", (lineSize * h * d), sizeBytes);
+        rsAssert(!"Allocation::read called with mismatched size");
+        return;
+    }
+    if (!checkRange3D(xoff, yoff, zoff, lod, w, h, d)) {
+        ALOGE("Allocation::read 3D range out of bounds");
+        return;
+    }
+
+    rsc->mHal.funcs.allocation.read3D(rsc, this, xoff, yoff, zoff, lod, face, w, h, d, data, sizeBytes);
+}
+
+bool Allocation::checkRange3D(uint32_t xoff, uint32_t yoff, uint32_t zoff, uint32_t lod,
+                              uint32_t w, uint32_t h, uint32_t d) const {
+    const Type *t = mHal.state.type;
+    if (lod >= t->getLODCount()) {
+        return false;
+    }
+    uint32_t dimX = t->getLODDimX(lod);
+    uint32_t dimY = rsMax(t->getLODDimY(lod), 1u);
+    uint32_t dimZ = rsMax(t->getLODDimZ(lod), 1u);
+    return (w <= dimX) && (xoff <= (dimX - w)) &&
+           (h <= dimY) && (yoff <= (dimY - h)) &&
+           (d <= dimZ) && (zoff <= (dimZ - d));
 }
 
 void Allocation::elementData(Context *rsc, uint32_t x, const void *data,
@@ -326,9 +471,14 @@ void Allocation::serialize(Context *rsc, OStream *stream) const {
     // Write how much data we are storing
     stream->addU32(packedSize);
     if (dataSize == packedSize) {
+        // The driver may pad rows, read1D returns them packed.
+        uint8_t *data = new uint8_t[dataSize];
+        rsc->mHal.funcs.allocation.read1D(rsc, this, 0, 0,
+                                          dataSize / getType()->getElementSizeBytes(),
+                                          data, dataSize);
         // Now write the data
-        stream->addByteArray(rsc->mHal.funcs.allocation.lock1D(rsc, this), dataSize);
-        rsc->mHal.funcs.allocation.unlock1D(rsc, this);
+        stream->addByteArray(data, dataSize);
+        delete[] data;
     } else {
         // Now write the data
         packVec3Allocation(rsc, stream);
@@ -415,6 +565,25 @@ bool Allocation::freeChildren() {
 }
 
 void Allocation::copyRange1D(Context *rsc, const Allocation *src, int32_t srcOff, int32_t destOff, int32_t len) {
+    if ((srcOff < 0) || (destOff < 0) || (len < 0)) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "Allocation::copyRange1D negative range");
+        return;
+    }
+    if (src->mHal.state.elementSizeBytes != mHal.state.elementSizeBytes) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "Allocation::copyRange1D element size mismatch");
+        return;
+    }
+    if (((uint32_t)(srcOff + len) > src->mHal.state.dimensionX) ||
+        ((uint32_t)(destOff + len) > mHal.state.dimensionX)) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "Allocation::copyRange1D out of bounds");
+        return;
+    }
+    if (!len) {
+        return;
+    }
+
+    rsc->mHal.funcs.allocation.allocData1D(rsc, this, destOff, 0, len, src, srcOff, 0);
+    sendDirty(rsc);
 }
 
 void Allocation::resize1D(Context *rsc, uint32_t dimX) {
@@ -422,13 +591,24 @@ void Allocation::resize1D(Context *rsc, uint32_t dimX) {
     if (dimX == oldDimX) {
         return;
     }
+    if (mHal.state.userProvidedPtr) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "Cannot resize a shared allocation");
+        return;
+    }
 
     ObjectBaseRef<Type> t = mHal.state.type->cloneAndResize1D(rsc, dimX);
     if (dimX < oldDimX) {
         decRefs(rsc->mHal.funcs.allocation.lock1D(rsc, this), oldDimX - dimX, dimX);
         rsc->mHal.funcs.allocation.unlock1D(rsc, this);
     }
-    rsc->mHal.funcs.allocation.resize(rsc, this, t.get(), mHal.state.hasReferences);
+    if (!rsc->mHal.funcs.allocation.resize(rsc, this, t.get(), mHal.state.hasReferences)) {
+        // The old contents are still there, take back what was released.
+        if (dimX < oldDimX) {
+            incRefs(rsc->mHal.funcs.allocation.lock1D(rsc, this), oldDimX - dimX, dimX);
+            rsc->mHal.funcs.allocation.unlock1D(rsc, this);
+        }
+        return;
+    }
     setType(t.get());
     updateCache();
 }
@@ -525,10 +705,29 @@ void rsi_Allocation2DData(Context *rsc, RsAllocation va, uint32_t xoff, uint32_t
     a->data(rsc, xoff, yoff, lod, face, w, h, data, sizeBytes);
 }
 
+void rsi_Allocation3DData(Context *rsc, RsAllocation va, uint32_t xoff, uint32_t yoff, uint32_t zoff,
+                          uint32_t lod, uint32_t w, uint32_t h, uint32_t d,
+                          const void *data, size_t sizeBytes) {
+    Allocation *a = static_cast<Allocation *>(va);
+    a->data(rsc, xoff, yoff, zoff, lod, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X,
+            w, h, d, data, sizeBytes);
+}
+
+void rsi_Allocation3DRead(Context *rsc, RsAllocation va, uint32_t xoff, uint32_t yoff, uint32_t zoff,
+                          uint32_t lod, uint32_t w, uint32_t h, uint32_t d,
+                          void *data, size_t sizeBytes) {
+    Allocation *a = static_cast<Allocation *>(va);
+    a->read(rsc, xoff, yoff, zoff, lod, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X,
+            w, h, d, data, sizeBytes);
+}
+
 void rsi_AllocationRead(Context *rsc, RsAllocation va, void *data, size_t sizeBytes) {
     Allocation *a = static_cast<Allocation *>(va);
     const Type * t = a->getType();
-    if(t->getDimY()) {
+    if(t->getDimZ()) {
+        a->read(rsc, 0, 0, 0, 0, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X,
+                t->getDimX(), t->getDimY(), t->getDimZ(), data, sizeBytes);
+    } else if(t->getDimY()) {
         a->read(rsc, 0, 0, 0, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X,
                 t->getDimX(), t->getDimY(), data, sizeBytes);
     } else {
@@ -549,7 +748,10 @@ void rsi_AllocationResize2D(Context *rsc, RsAllocation va, uint32_t dimX, uint32
 
 RsAllocation rsi_AllocationCreateTyped(Context *rsc, RsType vtype,
                                        RsAllocationMipmapControl mips,
-                                       uint32_t usages, uint32_t ptr) {
+                                       uint32_t usages, uintptr_t ptr) {
+    if (rsc->mCapture && ptr && (usages & RS_ALLOCATION_USAGE_SHARED)) {
+        rsc->mCapture->markUnreplayable("AllocationCreateTyped with caller memory");
+    }
     Allocation * alloc = Allocation::createAllocation(rsc, static_cast<Type *>(vtype), usages, mips, (void *)ptr);
     if (!alloc) {
         return NULL;
@@ -558,6 +760,29 @@ RsAllocation rsi_AllocationCreateTyped(Context *rsc, RsType vtype,
     return alloc;
 }
 
+RsAllocation rsi_AllocationCreateFromFile(Context *rsc, RsType vtype, uint32_t usages,
+                                          int32_t fd, size_t offset) {
+    if (rsc->mCapture) {
+        rsc->mCapture->markUnreplayable("AllocationCreateFromFile");
+    }
+    Allocation *alloc = Allocation::createFromFile(rsc, static_cast<Type *>(vtype),
+                                                   usages, fd, offset);
+    if (!alloc) {
+        return NULL;
+    }
+    alloc->incUserRef();
+    return alloc;
+}
+
+RsAllocation rsi_AllocationSnapshot(Context *rsc, RsAllocation va) {
+    Allocation *alloc = Allocation::createSnapshot(rsc, static_cast<Allocation *>(va));
+    if (!alloc) {
+        return NULL;
+    }
+    alloc->incUserRef();
+    return alloc;
+}
+
 RsAllocation rsi_AllocationCreateFromBitmap(Context *rsc, RsType vtype,
                                             RsAllocationMipmapControl mips,
                                             const void *data, size_t sizeBytes, uint32_t usages) {
@@ -635,6 +860,34 @@ void rsi_AllocationCopy2DRange(Context *rsc,
                                            (RsAllocationCubemapFace)srcFace);
 }
 
+void rsi_AllocationCopy3DRange(Context *rsc,
+                               RsAllocation dstAlloc,
+                               uint32_t dstXoff, uint32_t dstYoff, uint32_t dstZoff,
+                               uint32_t dstMip,
+                               uint32_t width, uint32_t height, uint32_t depth,
+                               RsAllocation srcAlloc,
+                               uint32_t srcXoff, uint32_t srcYoff, uint32_t srcZoff,
+                               uint32_t srcMip) {
+    Allocation *dst = static_cast<Allocation *>(dstAlloc);
+    Allocation *src = static_cast<Allocation *>(srcAlloc);
+    if (dst->getType()->getElement()->getSizeBytes() !=
+        src->getType()->getElement()->getSizeBytes()) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "AllocationCopy3DRange element size mismatch");
+        return;
+    }
+    if (!dst->checkRange3D(dstXoff, dstYoff, dstZoff, dstMip, width, height, depth) ||
+        !src->checkRange3D(srcXoff, srcYoff, srcZoff, srcMip, width, height, depth)) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "AllocationCopy3DRange out of bounds");
+        return;
+    }
+    rsc->mHal.funcs.allocation.allocData3D(rsc, dst, dstXoff, dstYoff, dstZoff, dstMip,
+                                           RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X,
+                                           width, height, depth,
+                                           src, srcXoff, srcYoff, srcZoff, srcMip,
+                                           RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+    dst->sendDirty(rsc);
+}
+
 int32_t rsi_AllocationGetSurfaceTextureID(Context *rsc, RsAllocation valloc) {
     Allocation *alloc = static_cast<Allocation *>(valloc);
     return alloc->getSurfaceTextureID(rsc);
@@ -61,7 +61,7 @@ public:
             bool hasMipmaps;
             bool hasFaces;
             bool hasReferences;
-            void * unused_01;
+            void * userProvidedPtr;
             int32_t surfaceTextureID;
             ANativeWindow *wndSurface;
             SurfaceTexture *surfaceTexture;
@@ -79,7 +79,16 @@ public:
 
     static Allocation * createAllocation(Context *rsc, const Type *, uint32_t usages,
                                          RsAllocationMipmapControl mc = RS_ALLOCATION_MIPMAP_NONE,
-                                         void *ptr = 0);
+                                         void *ptr = 0,
+                                         RsMemoryCategory category = RS_MEMORY_ALLOCATION);
+    // The allocation's storage is a private mapping of fd at offset, which
+    // must hold the packed contents of the type.
+    static Allocation * createFromFile(Context *rsc, const Type *type, uint32_t usages,
+                                       int fd, size_t offset);
+    static Allocation * createSnapshot(Context *rsc, const Allocation *src);
+    // Allocated from the context's SlabHeap.
+    static void * operator new(size_t size, Context *rsc) throw();
+    static void operator delete(void *ptr);
     virtual ~Allocation();
     void updateCache();
 
@@ -103,6 +112,8 @@ public:
                  uint32_t w, uint32_t h, void *data, size_t sizeBytes);
     void read(Context *rsc, uint32_t xoff, uint32_t yoff, uint32_t zoff, uint32_t lod, RsAllocationCubemapFace face,
                  uint32_t w, uint32_t h, uint32_t d, void *data, size_t sizeBytes);
+    bool checkRange3D(uint32_t xoff, uint32_t yoff, uint32_t zoff, uint32_t lod,
+                      uint32_t w, uint32_t h, uint32_t d) const;
 
     void elementData(Context *rsc, uint32_t x,
                      const void *data, uint32_t elementOff, size_t sizeBytes);
@@ -139,6 +150,9 @@ public:
         return mHal.state.mipmapControl != RS_ALLOCATION_MIPMAP_NONE;
     }
 
+    // What the driver counts the storage as, see Context::trackMemory.
+    RsMemoryCategory getMemoryCategory() const {return mMemoryCategory;}
+
     int32_t getSurfaceTextureID(const Context *rsc);
     void setSurfaceTexture(const Context *rsc, SurfaceTexture *st);
     void setSurface(const Context *rsc, RsNativeWindow sur);
@@ -148,6 +162,7 @@ public:
 protected:
     Vector<const Program *> mToDirtyList;
     ObjectBaseRef<const Type> mType;
+    RsMemoryCategory mMemoryCategory;
     void setType(const Type *t) {
         mType.set(t);
         mHal.state.type = t;
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rsContext.h"
+#include "rsCapture.h"
+#include "rsgApiStructs.h"
+
+using namespace android;
+using namespace android::renderscript;
+
+static const uint32_t CAPTURE_MAGIC = 0x50435352;   // "RSCP"
+static const uint32_t CAPTURE_VERSION = 1;
+static const size_t CAPTURE_ALIGN = 8;
+
+static uint32_t getCommandCount() {
+    return sizeof(gPlaybackFuncs) / sizeof(void *);
+}
+
+Capture::Capture() {
+    memset(&mHeader, 0, sizeof(mHeader));
+    mFile = NULL;
+    mOffset = 0;
+    mData = NULL;
+    mSize = 0;
+    mPos = 0;
+    mFailed = false;
+    mUnreplayable = false;
+    mScratch = NULL;
+    mScratchSize = 0;
+    mLock.init();
+}
+
+Capture::~Capture() {
+    if (mFile) {
+        fclose(mFile);
+    }
+    free(mData);
+    free(mScratch);
+}
+
+Capture * Capture::createWriter(const Context *rsc, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        ALOGE("Capture: could not open %s for writing", path);
+        return NULL;
+    }
+
+    Capture *cap = new Capture();
+    cap->mFile = f;
+    cap->mHeader.magic = CAPTURE_MAGIC;
+    cap->mHeader.version = CAPTURE_VERSION;
+    cap->mHeader.commandCount = getCommandCount();
+    cap->mHeader.pointerSize = sizeof(void *);
+    cap->mHeader.targetSdkVersion = rsc->getTargetSdkVersion();
+    cap->write(&cap->mHeader, sizeof(cap->mHeader));
+    return cap;
+}
+
+Capture * Capture::createReader(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        ALOGE("Capture: could not open %s", path);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < (long)sizeof(FileHeader)) {
+        ALOGE("Capture: %s is too short", path);
+        fclose(f);
+        return NULL;
+    }
+
+    Capture *cap = new Capture();
+    cap->mSize = size;
+    cap->mData = (uint8_t *)malloc(size);
+    if (!cap->mData || (fread(cap->mData, 1, size, f) != (size_t)size)) {
+        ALOGE("Capture: failed reading %s", path);
+        fclose(f);
+        delete cap;
+        return NULL;
+    }
+    fclose(f);
+
+    cap->read(&cap->mHeader, sizeof(cap->mHeader));
+    if ((cap->mHeader.magic != CAPTURE_MAGIC) ||
+        (cap->mHeader.version != CAPTURE_VERSION)) {
+        ALOGE("Capture: %s is not a capture file", path);
+        delete cap;
+        return NULL;
+    }
+    if ((cap->mHeader.commandCount != getCommandCount()) ||
+        (cap->mHeader.pointerSize != sizeof(void *))) {
+        ALOGE("Capture: %s was recorded by an incompatible build", path);
+        delete cap;
+        return NULL;
+    }
+    if (cap->mHeader.flags & FLAG_UNREPLAYABLE) {
+        ALOGE("Capture: %s uses caller memory or files and cannot be replayed", path);
+        delete cap;
+        return NULL;
+    }
+    return cap;
+}
+
+bool Capture::beginCommand(uint32_t cmdID) {
+    mLock.lock();
+    if (!mFile) {
+        mLock.unlock();
+        return false;
+    }
+    write(&cmdID, sizeof(cmdID));
+    return true;
+}
+
+void Capture::endCommand() {
+    mLock.unlock();
+}
+
+void Capture::close() {
+    mLock.lock();
+    if (mFile) {
+        if (mUnreplayable) {
+            mHeader.flags |= FLAG_UNREPLAYABLE;
+            fseek(mFile, 0, SEEK_SET);
+            fwrite(&mHeader, 1, sizeof(mHeader), mFile);
+        }
+        fclose(mFile);
+        mFile = NULL;
+    }
+    mLock.unlock();
+}
+
+void Capture::markUnreplayable(const char *what) {
+    if (!mUnreplayable) {
+        ALOGW("Capture: %s cannot be replayed, the capture will be refused", what);
+        mUnreplayable = true;
+    }
+}
+
+void Capture::write(const void *data, size_t bytes) {
+    // Stopped by an earlier failure, the rest of the command is dropped.
+    if (!mFile) {
+        return;
+    }
+    if (fwrite(data, 1, bytes, mFile) != bytes) {
+        ALOGE("Capture: write failed, capture stopped");
+        fclose(mFile);
+        mFile = NULL;
+        return;
+    }
+    mOffset += bytes;
+}
+
+void Capture::writeData(const void *data, size_t bytes) {
+    static const uint8_t pad[CAPTURE_ALIGN] = {0};
+    if (!mFile) {
+        return;
+    }
+    size_t padBytes = (CAPTURE_ALIGN - (mOffset & (CAPTURE_ALIGN - 1))) & (CAPTURE_ALIGN - 1);
+    if (padBytes) {
+        write(pad, padBytes);
+    }
+    if (bytes && mFile) {
+        write(data, bytes);
+    }
+}
+
+void Capture::read(void *data, size_t bytes) {
+    if ((mPos + bytes) > mSize) {
+        mFailed = true;
+        memset(data, 0, bytes);
+        mPos = mSize;
+        return;
+    }
+    memcpy(data, &mData[mPos], bytes);
+    mPos += bytes;
+}
+
+void * Capture::readData(size_t bytes) {
+    mPos = (mPos + CAPTURE_ALIGN - 1) & ~(CAPTURE_ALIGN - 1);
+    if ((mPos + bytes) > mSize) {
+        mFailed = true;
+        mPos = mSize;
+        return scratch(bytes);
+    }
+    void *ret = &mData[mPos];
+    mPos += bytes;
+    return ret;
+}
+
+void * Capture::scratch(size_t bytes) {
+    if (bytes > mScratchSize) {
+        free(mScratch);
+        mScratch = (uint8_t *)calloc(1, bytes);
+        mScratchSize = mScratch ? bytes : 0;
+    }
+    return mScratch;
+}
+
+void Capture::addObject(const void *captured, void *replayed) {
+    mObjects.add(captured, replayed);
+}
+
+void * Capture::lookupObject(const void *captured) const {
+    if (!captured) {
+        return NULL;
+    }
+    ssize_t idx = mObjects.indexOfKey(captured);
+    if (idx < 0) {
+        ALOGE("Capture: unknown object %p", captured);
+        return NULL;
+    }
+    return mObjects.valueAt(idx);
+}
+
+void Capture::lookupObjects(void *array, size_t bytes) const {
+    void **objs = (void **)array;
+    for (size_t ct = 0; ct < (bytes / sizeof(void *)); ct++) {
+        objs[ct] = lookupObject(objs[ct]);
+    }
+}
+
+bool Capture::replay(Context *con) {
+    // Data is used in place, so a capture can only be replayed once.
+    mPos = sizeof(FileHeader);
+    mObjects.clear();
+
+    while (!mFailed && (mPos < mSize)) {
+        uint32_t cmdID = 0;
+        read(&cmdID, sizeof(cmdID));
+        if ((cmdID >= getCommandCount()) || !gCaptureReplayFuncs[cmdID]) {
+            ALOGE("Capture: bad command %u at offset %zu", cmdID, mPos);
+            return false;
+        }
+        gCaptureReplayFuncs[cmdID](con, this);
+    }
+
+    if (mFailed) {
+        ALOGE("Capture: truncated file");
+    }
+    return !mFailed;
+}
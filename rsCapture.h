@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RS_CAPTURE_H
+#define ANDROID_RS_CAPTURE_H
+
+#include "rsUtils.h"
+#include "rsMutex.h"
+
+#include <stdio.h>
+#include <utils/KeyedVector.h>
+
+// ---------------------------------------------------------------------------
+namespace android {
+namespace renderscript {
+
+class Context;
+
+// Records the API calls made on a context to a file so they can be played
+// back later against a fresh context.  The per API writers and readers are
+// generated from rs.spec (CF_ in rsgApi.cpp, rspc_ in rsgApiReplay.cpp).
+//
+// File layout: a FileHeader, then one record per call.  A record is the
+// command id followed by the scalar parameters in declaration order, then
+// the data of each input pointer parameter, then the returned object handle
+// for calls which create objects.  Pointer data always starts on an 8 byte
+// boundary so the replay can use it in place.
+class Capture {
+public:
+    static Capture * createWriter(const Context *rsc, const char *path);
+    // Reads the whole file up front so file IO does not show up in the
+    // replay timing.
+    static Capture * createReader(const char *path);
+    ~Capture();
+
+    // Routes the public API through the recording entry points.  Generated
+    // in rsgApi.cpp.
+    static void installCaptureTable();
+
+    // Writer.  beginCommand returns false, without holding the lock, once
+    // the capture has been closed.
+    bool beginCommand(uint32_t cmdID);
+    void endCommand();
+    void write(const void *data, size_t bytes);
+    void writeData(const void *data, size_t bytes);
+    void close();
+    // For calls whose arguments only mean something in this process, such
+    // as caller memory or file descriptors.  The file is flagged on close
+    // and the reader refuses it.  Does not take the lock.
+    void markUnreplayable(const char *what);
+
+    // Reader.
+    uint32_t getTargetSdkVersion() const {return mHeader.targetSdkVersion;}
+    bool replay(Context *con);
+    void read(void *data, size_t bytes);
+    void * readData(size_t bytes);
+    void * scratch(size_t bytes);
+
+    void addObject(const void *captured, void *replayed);
+    void * lookupObject(const void *captured) const;
+    void lookupObjects(void *array, size_t bytes) const;
+
+protected:
+    Capture();
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        // Command ids and the pointer size must match between capture and
+        // replay.
+        uint32_t commandCount;
+        uint32_t pointerSize;
+        uint32_t targetSdkVersion;
+        uint32_t flags;
+    };
+    enum {
+        FLAG_UNREPLAYABLE = 0x0001
+    };
+    FileHeader mHeader;
+    volatile bool mUnreplayable;
+
+    FILE *mFile;
+    Mutex mLock;
+    size_t mOffset;
+
+    uint8_t *mData;
+    size_t mSize;
+    size_t mPos;
+    bool mFailed;
+
+    uint8_t *mScratch;
+    size_t mScratchSize;
+
+    KeyedVector<const void *, void *> mObjects;
+};
+
+}
+}
+#endif
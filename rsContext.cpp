@@ -19,6 +19,7 @@
 #include "rsContext.h"
 #include "rsThreadIO.h"
 #include "rsMesh.h"
+#include "rsCapture.h"
 #include <ui/FramebufferNativeWindow.h>
 #include <gui/DisplayEventReceiver.h>
 
@@ -76,6 +77,23 @@ Context::PushState::~PushState() {
     }
 }
 
+Context::SyncCall::SyncCall(Context *con, uint32_t cmdID) {
+    mRsc = con;
+    mCmdID = cmdID;
+    pthread_mutex_lock(&con->mSyncMutex);
+    // The driver keeps per thread state which is normally only set up for
+    // the context thread and its workers.
+    if (con->mHal.funcs.attachThread) {
+        con->mHal.funcs.attachThread(con);
+    }
+    mStart = con->mIO.commandStart();
+}
+
+Context::SyncCall::~SyncCall() {
+    mRsc->mIO.commandEnd(mCmdID, mStart);
+    pthread_mutex_unlock(&mRsc->mSyncMutex);
+}
+
 
 uint32_t Context::runScript(Script *s) {
     PushState ps(this);
@@ -220,6 +238,12 @@ void * Context::threadProc(void *vrsc) {
     rsc->props.mLogShadersUniforms = getProp("debug.rs.shader.uniforms") != 0;
     rsc->props.mLogVisual = getProp("debug.rs.visual") != 0;
     rsc->props.mDebugMaxThreads = getProp("debug.rs.max-threads");
+    rsc->props.mDebugAllocAlign = getProp("debug.rs.alloc.align");
+    rsc->props.mDebugAllocMapThreshold = getProp("debug.rs.alloc.mmap-threshold");
+    rsc->props.mDebugNoKernelFusion = getProp("debug.rs.sg.no-fusion") != 0;
+    if (getProp("debug.rs.profile.commands") != 0) {
+        rsc->mIO.setCommandStats(true);
+    }
 
     void *driverSO = NULL;
 
@@ -302,7 +326,9 @@ void * Context::threadProc(void *vrsc) {
 
     rsc->mRunning = true;
     if (!rsc->mIsGraphicsContext) {
-        while (!rsc->mExit) {
+        // Synchronous contexts execute commands on the caller's thread, this
+        // thread is only needed to bring up the driver.
+        while (!rsc->mExit && !rsc->mSynchronous) {
             rsc->mIO.playCoreCommands(rsc, -1);
         }
     } else {
@@ -371,6 +397,7 @@ void * Context::threadProc(void *vrsc) {
 
 void Context::destroyWorkerThreadResources() {
     //ALOGV("destroyWorkerThreadResources 1");
+    reclaimDeferred(SIZE_MAX);
     ObjectBase::zeroAllUserRef(this);
     if (mIsGraphicsContext) {
          mRaster.clear();
@@ -418,18 +445,31 @@ Context::Context() {
     mRunning = false;
     mExit = false;
     mPaused = false;
-    mObjHead = NULL;
+    mDeferredHead = 0;
     mError = RS_ERROR_NONE;
     mTargetSdkVersion = 14;
     mDPI = 96;
     mIsContextLite = false;
+    mSynchronous = false;
+    mCapture = NULL;
     memset(&watchdog, 0, sizeof(watchdog));
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mSyncMutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    pthread_mutex_init(&mMemoryMutex, NULL);
+    memset(mMemoryBytes, 0, sizeof(mMemoryBytes));
+    memset(mMemoryPeakBytes, 0, sizeof(mMemoryPeakBytes));
 }
 
-Context * Context::createContext(Device *dev, const RsSurfaceConfig *sc) {
+Context * Context::createContext(Device *dev, const RsSurfaceConfig *sc,
+                                 uint32_t flags) {
     Context * rsc = new Context();
 
-    if (!rsc->initContext(dev, sc)) {
+    if (!rsc->initContext(dev, sc, flags)) {
         delete rsc;
         return NULL;
     }
@@ -442,7 +482,7 @@ Context * Context::createContextLite() {
     return rsc;
 }
 
-bool Context::initContext(Device *dev, const RsSurfaceConfig *sc) {
+bool Context::initContext(Device *dev, const RsSurfaceConfig *sc, uint32_t flags) {
     pthread_mutex_lock(&gInitMutex);
 
     mIO.init();
@@ -457,6 +497,7 @@ bool Context::initContext(Device *dev, const RsSurfaceConfig *sc) {
     }
 
     mIsGraphicsContext = sc != NULL;
+    mSynchronous = !mIsGraphicsContext && (flags & RS_CONTEXT_SYNCHRONOUS);
 
     int status;
     pthread_attr_t threadAttr;
@@ -517,6 +558,9 @@ Context::~Context() {
         }
         pthread_mutex_unlock(&gInitMutex);
     }
+    pthread_mutex_destroy(&mSyncMutex);
+    pthread_mutex_destroy(&mMemoryMutex);
+    delete mCapture;
     ALOGV("%p Context::~Context done", this);
 }
 
@@ -633,6 +677,25 @@ void Context::removeName(ObjectBase *obj) {
     }
 }
 
+void Context::deferDestroy(ObjectBase *obj) {
+    mDeferredDestroys.push(obj);
+    // Bound the backlog when the queues never go idle.
+    if ((mDeferredDestroys.size() - mDeferredHead) >= RS_DEFERRED_DESTROY_LIMIT) {
+        reclaimDeferred(RS_DEFERRED_DESTROY_LIMIT);
+    }
+}
+
+void Context::reclaimDeferred(size_t max) {
+    size_t end = rsMin(mDeferredDestroys.size(), mDeferredHead + max);
+    while (mDeferredHead < end) {
+        mDeferredDestroys[mDeferredHead++]->decUserRef();
+    }
+    if (mDeferredHead == mDeferredDestroys.size()) {
+        mDeferredDestroys.clear();
+        mDeferredHead = 0;
+    }
+}
+
 RsMessageToClientType Context::peekMessageToClient(size_t *receiveLen, uint32_t *subID) {
     return (RsMessageToClientType)mIO.getClientHeader(receiveLen, subID);
 }
@@ -641,6 +704,11 @@ RsMessageToClientType Context::getMessageToClient(void *data, size_t *receiveLen
     return (RsMessageToClientType)mIO.getClientPayload(data, receiveLen, subID, bufferLen);
 }
 
+RsMessageToClientType Context::getMessagesToClient(void *data, size_t bufferLen,
+                                                   size_t *receiveLen, uint32_t *count) {
+    return mIO.getClientMessages(data, bufferLen, receiveLen, count);
+}
+
 bool Context::sendMessageToClient(const void *data, RsMessageToClientType cmdID,
                                   uint32_t subID, size_t len, bool waitForSpace) const {
 
@@ -657,11 +725,80 @@ void Context::deinitToClient() {
     mIO.clientShutdown();
 }
 
+bool Context::startCapture(const char *path) {
+    if (mCapture) {
+        ALOGE("Context %p already captured", this);
+        return false;
+    }
+    mCapture = Capture::createWriter(this, path);
+    if (!mCapture) {
+        return false;
+    }
+    Capture::installCaptureTable();
+    ALOGV("Capturing context %p to %s", this, path);
+    return true;
+}
+
+void Context::stopCapture() {
+    // The capture object stays around until the context is destroyed as
+    // other threads may still be inside a recorded call.
+    if (mCapture) {
+        mCapture->close();
+    }
+}
+
 void Context::setError(RsError e, const char *msg) const {
     mError = e;
     sendMessageToClient(msg, RS_MESSAGE_TO_CLIENT_ERROR, e, strlen(msg) + 1, true);
 }
 
+void Context::trackMemory(RsMemoryCategory category, ssize_t bytes) const {
+    rsAssert(category < RS_MEMORY_CATEGORY_COUNT);
+    pthread_mutex_lock(&mMemoryMutex);
+    size_t *held = &mMemoryBytes[category];
+    if ((bytes < 0) && ((size_t)-bytes > *held)) {
+        ALOGE("Memory category %i freed %zi bytes with %zu held", category, bytes, *held);
+        *held = 0;
+    } else {
+        *held += bytes;
+    }
+    if (*held > mMemoryPeakBytes[category]) {
+        mMemoryPeakBytes[category] = *held;
+    }
+    pthread_mutex_unlock(&mMemoryMutex);
+}
+
+void Context::getMemoryUsage(RsMemoryUsage *usage) const {
+    memset(usage, 0, sizeof(*usage));
+    pthread_mutex_lock(&mMemoryMutex);
+    memcpy(usage->bytes, mMemoryBytes, sizeof(usage->bytes));
+    memcpy(usage->peakBytes, mMemoryPeakBytes, sizeof(usage->peakBytes));
+    pthread_mutex_unlock(&mMemoryMutex);
+    ObjectBase::countAll(this, usage->objects, RS_A3D_CLASS_ID_COUNT);
+}
+
+void Context::dumpMemoryUsage() const {
+    static const char *names[RS_MEMORY_CATEGORY_COUNT] = {
+        "allocations", "driver scratch", "scripts (estimated)", "font cache",
+        "script group intermediates", "allocation pool"
+    };
+
+    RsMemoryUsage usage;
+    getMemoryUsage(&usage);
+    size_t total = 0;
+    for (uint32_t ct = 0; ct < RS_MEMORY_CATEGORY_COUNT; ct++) {
+        ALOGV("Memory: %-26s %12zu bytes, peak %12zu", names[ct],
+              usage.bytes[ct], usage.peakBytes[ct]);
+        total += usage.bytes[ct];
+    }
+    ALOGV("Memory: %-26s %12zu bytes", "total", total);
+    for (uint32_t ct = 0; ct < RS_A3D_CLASS_ID_COUNT; ct++) {
+        if (usage.objects[ct]) {
+            ALOGV("Objects: class %2u, %zu live", ct, usage.objects[ct]);
+        }
+    }
+}
+
 
 void Context::dumpDebug() const {
     ALOGE("RS Context debug %p", this);
@@ -679,6 +816,7 @@ namespace android {
 namespace renderscript {
 
 void rsi_ContextFinish(Context *rsc) {
+    rsc->reclaimDeferred(SIZE_MAX);
 }
 
 void rsi_ContextBindRootScript(Context *rsc, RsScript vs) {
@@ -730,7 +868,11 @@ void rsi_AssignName(Context *rsc, RsObjectBase obj, const char *name, size_t nam
 void rsi_ObjDestroy(Context *rsc, void *optr) {
     ObjectBase *ob = static_cast<ObjectBase *>(optr);
     rsc->removeName(ob);
-    ob->decUserRef();
+    if (rsc->isSynchronous()) {
+        ob->decUserRef();
+    } else {
+        rsc->deferDestroy(ob);
+    }
 }
 
 void rsi_ContextPause(Context *rsc) {
@@ -749,8 +891,46 @@ void rsi_ContextSetPriority(Context *rsc, int32_t p) {
     rsc->setPriority(p);
 }
 
+void rsi_ContextSetCommandStats(Context *rsc, bool enable) {
+    rsc->mIO.setCommandStats(enable);
+}
+
+void rsi_ContextSetAllocationPoolLimit(Context *rsc, size_t bytes) {
+    if (rsc->mHal.funcs.allocation.setPoolLimit) {
+        rsc->mHal.funcs.allocation.setPoolLimit(rsc, bytes);
+    }
+}
+
+void rsi_ContextTrimAllocationPool(Context *rsc, size_t bytes) {
+    if (rsc->mHal.funcs.allocation.trimPool) {
+        rsc->mHal.funcs.allocation.trimPool(rsc, bytes);
+    }
+}
+
 void rsi_ContextDump(Context *rsc, int32_t bits) {
     ObjectBase::dumpAll(rsc);
+    rsc->dumpMemoryUsage();
+    rsc->mIO.dumpCommandStats();
+    if (rsc->mHal.funcs.dump) {
+        rsc->mHal.funcs.dump(rsc);
+    }
+}
+
+void rsi_ContextGetMemoryUsage(Context *rsc, void *usage, size_t usage_length) {
+    if (usage_length != sizeof(RsMemoryUsage)) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "Memory usage size mismatch");
+        return;
+    }
+    rsc->getMemoryUsage((RsMemoryUsage *)usage);
+}
+
+uint32_t rsi_ContextGetCommandStats(Context *rsc, void *stats, size_t stats_length) {
+    if (stats_length % sizeof(RsCommandStats)) {
+        rsc->setError(RS_ERROR_BAD_VALUE, "Command stats size mismatch");
+        return 0;
+    }
+    return rsc->mIO.getCommandStats((RsCommandStats *)stats,
+                                    stats_length / sizeof(RsCommandStats));
 }
 
 void rsi_ContextDestroyWorker(Context *rsc) {
@@ -779,6 +959,14 @@ RsMessageToClientType rsi_ContextGetMessage(Context *rsc, void * data, size_t da
     return rsc->getMessageToClient(data, receiveLen, subID, data_length);
 }
 
+RsMessageToClientType rsi_ContextGetMessages(Context *rsc, void * data, size_t data_length,
+                                           size_t * receiveLen, size_t receiveLen_length,
+                                           uint32_t * count, size_t count_length) {
+    rsAssert(receiveLen_length == sizeof(size_t));
+    rsAssert(count_length == sizeof(uint32_t));
+    return rsc->getMessagesToClient(data, data_length, receiveLen, count);
+}
+
 void rsi_ContextInitToClient(Context *rsc) {
     rsc->initToClient();
 }
@@ -792,15 +980,38 @@ void rsi_ContextDeinitToClient(Context *rsc) {
 
 RsContext rsContextCreate(RsDevice vdev, uint32_t version,
                           uint32_t sdkVersion) {
-    ALOGV("rsContextCreate dev=%p", vdev);
+    return rsContextCreateWithFlags(vdev, version, sdkVersion, 0);
+}
+
+RsContext rsContextCreateWithFlags(RsDevice vdev, uint32_t version,
+                                   uint32_t sdkVersion, uint32_t flags) {
+    ALOGV("rsContextCreate dev=%p flags=%x", vdev, flags);
     Device * dev = static_cast<Device *>(vdev);
-    Context *rsc = Context::createContext(dev, NULL);
+    Context *rsc = Context::createContext(dev, NULL, flags);
     if (rsc) {
         rsc->setTargetSdkVersion(sdkVersion);
+
+        char path[PROPERTY_VALUE_MAX];
+        property_get("debug.rs.capture", path, "");
+        if (path[0]) {
+            String8 file(path);
+            file.appendFormat(".%d.%p", getpid(), rsc);
+            rsc->startCapture(file.string());
+        }
     }
     return rsc;
 }
 
+bool rsContextStartCapture(RsContext vrsc, const char *path) {
+    Context *rsc = static_cast<Context *>(vrsc);
+    return rsc->startCapture(path);
+}
+
+void rsContextStopCapture(RsContext vrsc) {
+    Context *rsc = static_cast<Context *>(vrsc);
+    rsc->stopCapture();
+}
+
 RsContext rsContextCreateGL(RsDevice vdev, uint32_t version,
                             uint32_t sdkVersion, RsSurfaceConfig sc,
                             uint32_t dpi) {
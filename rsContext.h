@@ -31,6 +31,7 @@
 #include "rsProgramRaster.h"
 #include "rsProgramVertex.h"
 #include "rsFBOCache.h"
+#include "rsSlab.h"
 #include <string.h>
 
 // ---------------------------------------------------------------------------
@@ -39,6 +40,12 @@ namespace android {
 namespace renderscript {
 
 class Device;
+class Capture;
+
+// Objects released by the client are reclaimed this many at a time when
+// the command queues go idle, and immediately once this many are waiting.
+#define RS_DEFERRED_DESTROY_BATCH 64
+#define RS_DEFERRED_DESTROY_LIMIT 4096
 
 #if 0
 #define CHECK_OBJ(o) { \
@@ -67,7 +74,8 @@ public:
     };
     Hal mHal;
 
-    static Context * createContext(Device *, const RsSurfaceConfig *sc);
+    static Context * createContext(Device *, const RsSurfaceConfig *sc,
+                                   uint32_t flags = 0);
     static Context * createContextLite();
     ~Context();
 
@@ -89,6 +97,19 @@ public:
         Context *mRsc;
     };
 
+    // Serializes commands executed directly on caller threads when the
+    // context was created with RS_CONTEXT_SYNCHRONOUS.
+    class SyncCall {
+    public:
+        SyncCall(Context *, uint32_t cmdID);
+        ~SyncCall();
+
+    private:
+        Context *mRsc;
+        uint32_t mCmdID;
+        uint64_t mStart;
+    };
+
     RsSurfaceConfig mUserSurfaceConfig;
 
     ElementState mStateElement;
@@ -131,8 +152,17 @@ public:
     void assignName(ObjectBase *obj, const char *name, uint32_t len);
     void removeName(ObjectBase *obj);
 
+    // Objects released by the client are destroyed in batches while the
+    // command queues are idle rather than as each ObjDestroy arrives.
+    // Only used from the command thread.
+    void deferDestroy(ObjectBase *obj);
+    bool hasDeferredDestroys() const {return mDeferredHead < mDeferredDestroys.size();}
+    // Releases up to max deferred objects in the order they arrived.
+    void reclaimDeferred(size_t max);
+
     RsMessageToClientType peekMessageToClient(size_t *receiveLen, uint32_t *subID);
     RsMessageToClientType getMessageToClient(void *data, size_t *receiveLen, uint32_t *subID, size_t bufferLen);
+    RsMessageToClientType getMessagesToClient(void *data, size_t bufferLen, size_t *receiveLen, uint32_t *count);
     bool sendMessageToClient(const void *data, RsMessageToClientType cmdID, uint32_t subID, size_t len, bool waitForSpace) const;
     uint32_t runScript(Script *s);
 
@@ -187,6 +217,9 @@ public:
         bool mLogShadersUniforms;
         bool mLogVisual;
         uint32_t mDebugMaxThreads;
+        uint32_t mDebugAllocAlign;
+        uint32_t mDebugAllocMapThreshold;
+        bool mDebugNoKernelFusion;
     } props;
 
     mutable struct {
@@ -205,7 +238,15 @@ public:
     void dumpDebug() const;
     void setError(RsError e, const char *msg = NULL) const;
 
-    mutable const ObjectBase * mObjHead;
+    // Adds bytes, negative when freeing, to a memory category.  Safe to
+    // call from any thread.
+    void trackMemory(RsMemoryCategory category, ssize_t bytes) const;
+    void getMemoryUsage(RsMemoryUsage *usage) const;
+    void dumpMemoryUsage() const;
+
+    mutable ObjectRegistry mObjects;
+    // Storage for the small objects created most often, see rsSlab.h.
+    mutable SlabHeap mSlabs;
 
     uint32_t getDPI() const {return mDPI;}
     void setDPI(uint32_t dpi) {mDPI = dpi;}
@@ -213,6 +254,13 @@ public:
     uint32_t getTargetSdkVersion() const {return mTargetSdkVersion;}
     void setTargetSdkVersion(uint32_t sdkVer) {mTargetSdkVersion = sdkVer;}
 
+    bool isSynchronous() const {return mSynchronous;}
+
+    // API call recording, see rsCapture.h.
+    bool startCapture(const char *path);
+    void stopCapture();
+    Capture *mCapture;
+
     Device *mDev;
 protected:
 
@@ -242,7 +290,7 @@ protected:
 
 private:
     Context();
-    bool initContext(Device *, const RsSurfaceConfig *sc);
+    bool initContext(Device *, const RsSurfaceConfig *sc, uint32_t flags);
 
 
     bool initGLThread();
@@ -255,9 +303,18 @@ private:
 
     bool mHasSurface;
     bool mIsContextLite;
+    bool mSynchronous;
+    pthread_mutex_t mSyncMutex;
+
+    mutable pthread_mutex_t mMemoryMutex;
+    mutable size_t mMemoryBytes[RS_MEMORY_CATEGORY_COUNT];
+    mutable size_t mMemoryPeakBytes[RS_MEMORY_CATEGORY_COUNT];
 
     Vector<ObjectBase *> mNames;
 
+    Vector<ObjectBase *> mDeferredDestroys;
+    size_t mDeferredHead;
+
     uint64_t mTimers[_RS_TIMER_TOTAL];
     Timers mTimerActive;
     uint64_t mTimeLast;
@@ -76,6 +76,13 @@ enum RsDeviceParam {
     RS_DEVICE_PARAM_COUNT
 };
 
+enum RsContextFlags {
+    // Compute only. Commands are executed on the calling thread instead of
+    // being queued to the context thread. Avoids the fifo copy and the
+    // thread wakeup for every call at the cost of blocking the caller.
+    RS_CONTEXT_SYNCHRONOUS = 0x0001
+};
+
 typedef struct {
     uint32_t colorMin;
     uint32_t colorPref;
@@ -98,6 +105,15 @@ enum RsMessageToClientType {
     RS_MESSAGE_TO_CLIENT_USER = 4
 };
 
+// Record layout used by rsContextGetMessages.  Each record is followed by
+// bytes of payload and the next record starts stride bytes after this one.
+typedef struct {
+    uint32_t msgType;
+    uint32_t userID;
+    uint32_t bytes;
+    uint32_t stride;
+} RsMessageToClientHeader;
+
 enum RsAllocationUsageType {
     RS_ALLOCATION_USAGE_SCRIPT = 0x0001,
     RS_ALLOCATION_USAGE_GRAPHICS_TEXTURE = 0x0002,
@@ -106,6 +122,11 @@ enum RsAllocationUsageType {
     RS_ALLOCATION_USAGE_GRAPHICS_RENDER_TARGET = 0x0010,
     RS_ALLOCATION_USAGE_IO_INPUT = 0x0020,
     RS_ALLOCATION_USAGE_IO_OUTPUT = 0x0040,
+    // The allocation's storage is the caller's memory passed at creation,
+    // with rows packed.  The memory must outlive the allocation and may
+    // only be touched by the caller once rsContextFinish has returned
+    // after the last command using the allocation.  Script usage only.
+    RS_ALLOCATION_USAGE_SHARED = 0x0080,
 
     RS_ALLOCATION_USAGE_ALL = 0x00FF
 };
@@ -357,6 +378,44 @@ typedef struct {
     const char* objectName;
 } RsFileIndexEntry;
 
+#define RS_A3D_CLASS_ID_COUNT (RS_A3D_CLASS_ID_SCRIPT_GROUP + 1)
+
+// Memory held by a context, counted as it is allocated and freed.
+enum RsMemoryCategory {
+    RS_MEMORY_ALLOCATION = 0,       // Allocation storage owned by the driver.
+    RS_MEMORY_DRIVER_SCRATCH = 1,   // Per worker scratch buffers of intrinsics.
+    RS_MEMORY_SCRIPT = 2,           // Compiled script executables, estimated.
+    RS_MEMORY_FONT_CACHE = 3,       // Glyph cache and its texture.
+    RS_MEMORY_SCRIPT_GROUP = 4,     // ScriptGroup intermediate allocations.
+    RS_MEMORY_ALLOCATION_POOL = 5,  // Released storage kept for reuse.
+    RS_MEMORY_CATEGORY_COUNT
+};
+
+// Filled in by rsContextGetMemoryUsage.  Memory shared with the caller,
+// such as RS_ALLOCATION_USAGE_SHARED storage, is not counted.  Snapshots
+// are counted at their full size although they share unwritten pages.
+// RS_MEMORY_SCRIPT is an estimate taken from the size of each script's
+// cached object file, or its bitcode, not the memory of the loaded image.
+typedef struct {
+    size_t bytes[RS_MEMORY_CATEGORY_COUNT];
+    size_t peakBytes[RS_MEMORY_CATEGORY_COUNT];
+    size_t objects[RS_A3D_CLASS_ID_COUNT];      // Live objects by class.
+} RsMemoryUsage;
+
+// Filled in by rsContextGetCommandStats, one entry per command id.  Times
+// are in ns.  Histogram bucket 0 counts latencies under 1us, bucket n
+// latencies in [2^(n-1), 2^n) us, and the last bucket everything longer.
+// Commands of synchronous contexts have no queue wait.
+#define RS_COMMAND_STATS_BUCKETS 24
+typedef struct {
+    const char *name;
+    uint32_t count;
+    uint64_t waitTotal;
+    uint64_t execTotal;
+    uint32_t waitHist[RS_COMMAND_STATS_BUCKETS];
+    uint32_t execHist[RS_COMMAND_STATS_BUCKETS];
+} RsCommandStats;
+
 enum RsForEachStrategy {
     RS_FOR_EACH_STRATEGY_SERIAL = 0,
     RS_FOR_EACH_STRATEGY_DONT_CARE = 1,
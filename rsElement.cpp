@@ -27,6 +27,10 @@ Element::Element(Context *rsc) : ObjectBase(rsc) {
     mFields = NULL;
     mFieldCount = 0;
     mHasReference = false;
+    mRefOffsets = NULL;
+    mRefOffsetCount = 0;
+    mCacheHash = 0;
+    mCacheNext = NULL;
     memset(&mHal, 0, sizeof(mHal));
 }
 
@@ -35,12 +39,7 @@ Element::~Element() {
 }
 
 void Element::preDestroy() const {
-    for (uint32_t ct = 0; ct < mRSC->mStateElement.mElements.size(); ct++) {
-        if (mRSC->mStateElement.mElements[ct] == this) {
-            mRSC->mStateElement.mElements.removeAt(ct);
-            break;
-        }
-    }
+    mRSC->mStateElement.mElements.remove(this);
 }
 
 void Element::clear() {
@@ -48,6 +47,9 @@ void Element::clear() {
     mFields = NULL;
     mFieldCount = 0;
     mHasReference = false;
+    delete [] mRefOffsets;
+    mRefOffsets = NULL;
+    mRefOffsetCount = 0;
 
     delete [] mHal.state.fields;
     delete [] mHal.state.fieldArraySizes;
@@ -174,6 +176,7 @@ void Element::compute() {
         mHasReference = mComponent.isReference();
 
         mHal.state.elementSizeBytes = getSizeBytes();
+        computeRefOffsets();
         return;
     }
 
@@ -217,16 +220,71 @@ void Element::compute() {
     }
 
     mHal.state.elementSizeBytes = getSizeBytes();
+    computeRefOffsets();
+}
+
+void Element::computeRefOffsets() {
+    if (!mHasReference) {
+        return;
+    }
+    if (!mFieldCount) {
+        mRefOffsets = new uint32_t[1];
+        mRefOffsets[0] = 0;
+        mRefOffsetCount = 1;
+        return;
+    }
+
+    // Fields are created before us so their tables are complete.
+    size_t count = 0;
+    for (size_t ct = 0; ct < mFieldCount; ct++) {
+        count += mFields[ct].e->mRefOffsetCount * mFields[ct].arraySize;
+    }
+    mRefOffsets = new uint32_t[count];
+    mRefOffsetCount = count;
+
+    size_t idx = 0;
+    for (size_t ct = 0; ct < mFieldCount; ct++) {
+        const Element *e = mFields[ct].e.get();
+        uint32_t offset = mFields[ct].offsetBits >> 3;
+        for (uint32_t i = 0; i < mFields[ct].arraySize; i++) {
+            for (size_t r = 0; r < e->mRefOffsetCount; r++) {
+                mRefOffsets[idx++] = offset + e->mRefOffsets[r];
+            }
+            offset += e->getSizeBytes();
+        }
+    }
+    rsAssert(idx == count);
+}
+
+uint32_t Element::hashKey(RsDataType dt, RsDataKind dk, bool isNorm, uint32_t vecSize) {
+    uint32_t hash = rsHashMix(RS_HASH_SEED, 0);
+    hash = rsHashMix(hash, dt);
+    hash = rsHashMix(hash, dk);
+    hash = rsHashMix(hash, isNorm);
+    return rsHashMix(hash, vecSize);
+}
+
+uint32_t Element::hashKey(size_t count, const Element **ein, const char **nin,
+                          const size_t *lengths, const uint32_t *asin) {
+    uint32_t hash = rsHashMix(RS_HASH_SEED, count);
+    for (size_t ct = 0; ct < count; ct++) {
+        hash = rsHashPtr(hash, ein[ct]);
+        hash = rsHashBytes(hash, nin[ct], lengths[ct]);
+        hash = rsHashMix(hash, asin[ct]);
+    }
+    return hash;
 }
 
 ObjectBaseRef<const Element> Element::createRef(Context *rsc, RsDataType dt, RsDataKind dk,
                                 bool isNorm, uint32_t vecSize) {
     ObjectBaseRef<const Element> returnRef;
+    uint32_t hash = hashKey(dt, dk, isNorm, vecSize);
+
     // Look for an existing match.
     ObjectBase::asyncLock();
-    for (uint32_t ct=0; ct < rsc->mStateElement.mElements.size(); ct++) {
-        const Element *ee = rsc->mStateElement.mElements[ct];
-        if (!ee->getFieldCount() &&
+    for (const Element *ee = rsc->mStateElement.mElements.find(hash); ee; ee = ee->mCacheNext) {
+        if ((ee->mCacheHash == hash) &&
+            !ee->getFieldCount() &&
             (ee->getComponent().getType() == dt) &&
             (ee->getComponent().getKind() == dk) &&
             (ee->getComponent().getIsNormalized() == isNorm) &&
@@ -243,9 +301,10 @@ ObjectBaseRef<const Element> Element::createRef(Context *rsc, RsDataType dt, RsD
     returnRef.set(e);
     e->mComponent.set(dt, dk, isNorm, vecSize);
     e->compute();
+    e->mCacheHash = hash;
 
     ObjectBase::asyncLock();
-    rsc->mStateElement.mElements.push(e);
+    rsc->mStateElement.mElements.add(e);
     ObjectBase::asyncUnlock();
 
     return returnRef;
@@ -255,11 +314,12 @@ ObjectBaseRef<const Element> Element::createRef(Context *rsc, size_t count, cons
                             const char **nin, const size_t * lengths, const uint32_t *asin) {
 
     ObjectBaseRef<const Element> returnRef;
+    uint32_t hash = hashKey(count, ein, nin, lengths, asin);
+
     // Look for an existing match.
     ObjectBase::asyncLock();
-    for (uint32_t ct=0; ct < rsc->mStateElement.mElements.size(); ct++) {
-        const Element *ee = rsc->mStateElement.mElements[ct];
-        if (ee->getFieldCount() == count) {
+    for (const Element *ee = rsc->mStateElement.mElements.find(hash); ee; ee = ee->mCacheNext) {
+        if ((ee->mCacheHash == hash) && (ee->getFieldCount() == count)) {
             bool match = true;
             for (uint32_t i=0; i < count; i++) {
                 if ((ee->mFields[i].e.get() != ein[i]) ||
@@ -289,56 +349,73 @@ ObjectBaseRef<const Element> Element::createRef(Context *rsc, size_t count, cons
         e->mFields[ct].arraySize = asin[ct];
     }
     e->compute();
+    e->mCacheHash = hash;
 
     ObjectBase::asyncLock();
-    rsc->mStateElement.mElements.push(e);
+    rsc->mStateElement.mElements.add(e);
     ObjectBase::asyncUnlock();
 
     return returnRef;
 }
 
 void Element::incRefs(const void *ptr) const {
-    if (!mFieldCount) {
-        if (mComponent.isReference()) {
-            ObjectBase *const*obp = static_cast<ObjectBase *const*>(ptr);
-            ObjectBase *ob = obp[0];
-            if (ob) ob->incSysRef();
-        }
-        return;
-    }
+    incRefs(ptr, 1);
+}
 
+void Element::decRefs(const void *ptr) const {
+    decRefs(ptr, 1);
+}
+
+// Runs of references to the same object, such as arrays filled with one
+// handle, are counted with a single atomic update.
+void Element::incRefs(const void *ptr, size_t ct) const {
     const uint8_t *p = static_cast<const uint8_t *>(ptr);
-    for (uint32_t i=0; i < mFieldCount; i++) {
-        if (mFields[i].e->mHasReference) {
-            const uint8_t *p2 = &p[mFields[i].offsetBits >> 3];
-            for (uint32_t ct=0; ct < mFields[i].arraySize; ct++) {
-                mFields[i].e->incRefs(p2);
-                p2 += mFields[i].e->getSizeBytes();
+    const size_t stride = getSizeBytes();
+    const ObjectBase *run = NULL;
+    int32_t runCount = 0;
+
+    for (size_t i = 0; i < ct; i++, p += stride) {
+        for (size_t r = 0; r < mRefOffsetCount; r++) {
+            const ObjectBase *ob = *reinterpret_cast<ObjectBase *const *>(p + mRefOffsets[r]);
+            if (ob == run) {
+                runCount++;
+                continue;
+            }
+            if (run) {
+                run->incSysRefs(runCount);
             }
+            run = ob;
+            runCount = 1;
         }
     }
-}
-
-void Element::decRefs(const void *ptr) const {
-    if (!mFieldCount) {
-        if (mComponent.isReference()) {
-            ObjectBase *const*obp = static_cast<ObjectBase *const*>(ptr);
-            ObjectBase *ob = obp[0];
-            if (ob) ob->decSysRef();
-        }
-        return;
+    if (run) {
+        run->incSysRefs(runCount);
     }
+}
 
+void Element::decRefs(const void *ptr, size_t ct) const {
     const uint8_t *p = static_cast<const uint8_t *>(ptr);
-    for (uint32_t i=0; i < mFieldCount; i++) {
-        if (mFields[i].e->mHasReference) {
-            const uint8_t *p2 = &p[mFields[i].offsetBits >> 3];
-            for (uint32_t ct=0; ct < mFields[i].arraySize; ct++) {
-                mFields[i].e->decRefs(p2);
-                p2 += mFields[i].e->getSizeBytes();
+    const size_t stride = getSizeBytes();
+    const ObjectBase *run = NULL;
+    int32_t runCount = 0;
+
+    for (size_t i = 0; i < ct; i++, p += stride) {
+        for (size_t r = 0; r < mRefOffsetCount; r++) {
+            const ObjectBase *ob = *reinterpret_cast<ObjectBase *const *>(p + mRefOffsets[r]);
+            if (ob == run) {
+                runCount++;
+                continue;
             }
+            if (run) {
+                run->decSysRefs(runCount);
+            }
+            run = ob;
+            runCount = 1;
         }
     }
+    if (run) {
+        run->decSysRefs(runCount);
+    }
 }
 
 Element::Builder::Builder() {
@@ -21,6 +21,7 @@
 #include "rsUtils.h"
 #include "rsDefines.h"
 #include "rsObjectBase.h"
+#include "rsObjectCache.h"
 
 // ---------------------------------------------------------------------------
 namespace android {
@@ -141,6 +142,9 @@ public:
 
     void incRefs(const void *) const;
     void decRefs(const void *) const;
+    // Same for ct consecutive elements.
+    void incRefs(const void *, size_t ct) const;
+    void decRefs(const void *, size_t ct) const;
     bool getHasReferences() const {return mHasReference;}
 
 protected:
@@ -158,6 +162,20 @@ protected:
     size_t mFieldCount;
     bool mHasReference;
 
+    // Byte offsets of every object reference in one element, flattened
+    // through nested structures and arrays by compute().
+    uint32_t *mRefOffsets;
+    size_t mRefOffsetCount;
+    void computeRefOffsets();
+
+    // Identity in ElementState's cache.
+    friend class ObjectCache<Element>;
+    static uint32_t hashKey(RsDataType dt, RsDataKind dk, bool isNorm, uint32_t vecSize);
+    static uint32_t hashKey(size_t count, const Element **ein, const char **nin,
+                            const size_t *lengths, const uint32_t *asin);
+    uint32_t mCacheHash;
+    mutable Element *mCacheNext;
+
 
     virtual ~Element();
     Element(Context *);
@@ -169,6 +187,7 @@ protected:
     void compute();
 
     virtual void preDestroy() const;
+    virtual bool isCached() const {return true;}
 };
 
 
@@ -177,8 +196,8 @@ public:
     ElementState();
     ~ElementState();
 
-    // Cache of all existing elements.
-    Vector<Element *> mElements;
+    // Cache of all existing elements, keyed on their structure.
+    ObjectCache<Element> mElements;
 };
 
 
@@ -20,11 +20,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include <unistd.h>
 #include <poll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 using namespace android;
 using namespace android::renderscript;
@@ -64,6 +66,27 @@ bool FifoSocket::writeAsync(const void *data, size_t bytes, bool waitForSpace) {
     return true;
 }
 
+bool FifoSocket::writeMessageAsync(const void *hdr, size_t hdrBytes,
+                                   const void *data, size_t bytes) {
+    struct iovec iov[2];
+    iov[0].iov_base = (void *)hdr;
+    iov[0].iov_len = hdrBytes;
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = bytes;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = bytes ? 2 : 1;
+
+    size_t ret = ::sendmsg(sv[0], &msg, 0);
+    rsAssert(ret == (hdrBytes + bytes));
+    if (ret != (hdrBytes + bytes)) {
+        ALOGE("writeMessageAsync %p %zu  ret %zu", data, hdrBytes + bytes, ret);
+    }
+    return true;
+}
+
 void FifoSocket::writeWaitReturn(void *retData, size_t retBytes) {
     if (mShutdown) {
         return;
@@ -90,6 +113,18 @@ size_t FifoSocket::read(void *data, size_t bytes) {
     return ret;
 }
 
+size_t FifoSocket::peek(void *data, size_t bytes) {
+    if (mShutdown) {
+        return 0;
+    }
+
+    size_t ret = ::recv(sv[1], data, bytes, MSG_WAITALL | MSG_PEEK);
+    if (mShutdown) {
+        ret = 0;
+    }
+    return ret;
+}
+
 bool FifoSocket::isEmpty() {
     struct pollfd p;
     p.fd = sv[1];
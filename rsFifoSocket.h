@@ -35,8 +35,11 @@ public:
     void shutdown();
 
     bool writeAsync(const void *data, size_t bytes, bool waitForSpace = true);
+    // Writes a header and its payload with a single call.
+    bool writeMessageAsync(const void *hdr, size_t hdrBytes, const void *data, size_t bytes);
     void writeWaitReturn(void *ret, size_t retSize);
     size_t read(void *data, size_t bytes);
+    size_t peek(void *data, size_t bytes);
     void readReturn(const void *data, size_t bytes);
     bool isEmpty();
 
@@ -333,6 +333,7 @@ FontState::FontState() {
     mMaxNumberOfQuads = 1024;
     mCurrentQuadIndex = 0;
     mRSC = NULL;
+    mCacheBuffer = NULL;
 #ifndef ANDROID_RS_SERIALIZE
     mLibrary = NULL;
 #endif //ANDROID_RS_SERIALIZE
@@ -547,10 +548,12 @@ void FontState::initTextTexture() {
     ObjectBaseRef<Type> texType = Type::getTypeRef(mRSC, alphaElem.get(),
                                                    mCacheWidth, mCacheHeight, 0, false, false);
     mCacheBuffer = new uint8_t[mCacheWidth * mCacheHeight];
+    mRSC->trackMemory(RS_MEMORY_FONT_CACHE, mCacheWidth * mCacheHeight);
 
 
     Allocation *cacheAlloc = Allocation::createAllocation(mRSC, texType.get(),
-                                RS_ALLOCATION_USAGE_GRAPHICS_TEXTURE);
+                                RS_ALLOCATION_USAGE_GRAPHICS_TEXTURE, RS_ALLOCATION_MIPMAP_NONE,
+                                NULL, RS_MEMORY_FONT_CACHE);
     mTextTexture.set(cacheAlloc);
 
     // Split up our cache texture into lines of certain widths
@@ -821,6 +824,11 @@ void FontState::deinit(Context *rsc) {
     mFontProgramStore.clear();
 
     mTextTexture.clear();
+    if (mCacheBuffer) {
+        delete[] mCacheBuffer;
+        mCacheBuffer = NULL;
+        rsc->trackMemory(RS_MEMORY_FONT_CACHE, -(ssize_t)(mCacheWidth * mCacheHeight));
+    }
     for (uint32_t i = 0; i < mCacheLines.size(); i ++) {
         delete mCacheLines[i];
     }
@@ -121,6 +121,7 @@ protected:
     bool init(const char *name, float fontSize, uint32_t dpi, const void *data = NULL, uint32_t dataLen = 0);
 
     virtual void preDestroy() const;
+    virtual bool isCached() const {return true;}
     FT_FaceRec_ *mFace;
     bool mInitialized;
     bool mHasKerning;
@@ -44,14 +44,12 @@ ObjectBase::~ObjectBase() {
     mStack.dump();
 #endif
 
-    if (mPrev || mNext) {
+    if (mPrev) {
         // While the normal practice is to call remove before we call
         // delete.  Its possible for objects without a re-use list
         // for avoiding duplication to be created on the stack.  In those
         // cases we need to remove ourself here.
-        asyncLock();
         remove();
-        asyncUnlock();
     }
 
     rsAssert(!mUserRefCount);
@@ -78,6 +76,10 @@ void ObjectBase::incSysRef() const {
     //ALOGV("ObjectBase %p incS ref %i, %i", this, mUserRefCount, mSysRefCount);
 }
 
+void ObjectBase::incSysRefs(int32_t count) const {
+    android_atomic_add(count, &mSysRefCount);
+}
+
 void ObjectBase::preDestroy() const {
 }
 
@@ -90,12 +92,17 @@ bool ObjectBase::checkDelete(const ObjectBase *ref) {
         return false;
     }
 
-    asyncLock();
-    // This lock protects us against the non-RS threads changing
-    // the ref counts.  At this point we should be the only thread
-    // working on them.
+    // Cached objects can gain references through a lookup until they are
+    // out of the cache, which is done under the async lock.  Others can
+    // only be reached through the references counted here.
+    bool cached = ref->isCached();
+    if (cached) {
+        asyncLock();
+    }
     if (ref->mUserRefCount || ref->mSysRefCount) {
-        asyncUnlock();
+        if (cached) {
+            asyncUnlock();
+        }
         return false;
     }
 
@@ -103,7 +110,9 @@ bool ObjectBase::checkDelete(const ObjectBase *ref) {
     // At this point we can unlock because there should be no possible way
     // for another thread to reference this object.
     ref->preDestroy();
-    asyncUnlock();
+    if (cached) {
+        asyncUnlock();
+    }
     delete ref;
     return true;
 }
@@ -144,6 +153,15 @@ bool ObjectBase::decSysRef() const {
     return false;
 }
 
+bool ObjectBase::decSysRefs(int32_t count) const {
+    rsAssert(mSysRefCount >= count);
+    if ((android_atomic_add(-count, &mSysRefCount) <= count) &&
+        (android_atomic_acquire_load(&mUserRefCount) <= 0)) {
+        return checkDelete(this);
+    }
+    return false;
+}
+
 void ObjectBase::setName(const char *name) {
     mName.setTo(name);
 }
@@ -161,18 +179,8 @@ void ObjectBase::asyncUnlock() {
 }
 
 void ObjectBase::add() const {
-    asyncLock();
-
-    rsAssert(!mNext);
-    rsAssert(!mPrev);
     //ALOGV("calling add  rsc %p", mRSC);
-    mNext = mRSC->mObjHead;
-    if (mRSC->mObjHead) {
-        mRSC->mObjHead->mPrev = this;
-    }
-    mRSC->mObjHead = this;
-
-    asyncUnlock();
+    mRSC->mObjects.add(this);
 }
 
 void ObjectBase::remove() const {
@@ -182,18 +190,22 @@ void ObjectBase::remove() const {
         rsAssert(!mNext);
         return;
     }
+    mRSC->mObjects.remove(this);
+}
 
-    if (mRSC->mObjHead == this) {
-        mRSC->mObjHead = mNext;
-    }
-    if (mPrev) {
-        mPrev->mNext = mNext;
-    }
-    if (mNext) {
-        mNext->mPrev = mPrev;
+// Collects every object of the context and takes a system reference on
+// each, so none of them can be deleted until released by the caller.
+void ObjectBase::pinAll(const Context *rsc, Vector<const ObjectBase *> *objs) {
+    for (uint32_t shard = 0; shard < ObjectRegistry::SHARD_COUNT; shard++) {
+        rsc->mObjects.lockShard(shard);
+        const ObjectBase * o = rsc->mObjects.getHead(shard);
+        while (o) {
+            o->incSysRef();
+            objs->push(o);
+            o = o->mNext;
+        }
+        rsc->mObjects.unlockShard(shard);
     }
-    mPrev = NULL;
-    mNext = NULL;
 }
 
 void ObjectBase::zeroAllUserRef(Context *rsc) {
@@ -201,18 +213,16 @@ void ObjectBase::zeroAllUserRef(Context *rsc) {
         ALOGV("Forcing release of all outstanding user refs.");
     }
 
-    // This operation can be slow, only to be called during context cleanup.
-    const ObjectBase * o = rsc->mObjHead;
-    while (o) {
-        //ALOGE("o %p", o);
-        if (o->zeroUserRef()) {
-            // deleted the object and possibly others, restart from head.
-            o = rsc->mObjHead;
-            //ALOGE("o head %p", o);
-        } else {
-            o = o->mNext;
-            //ALOGE("o next %p", o);
-        }
+    // Zero the user refs of everything first, then drop the pins.  An
+    // object whose last ref goes releases its children as usual; those
+    // not yet unpinned are deleted when their own pin is dropped.
+    Vector<const ObjectBase *> objs;
+    pinAll(rsc, &objs);
+    for (size_t ct = 0; ct < objs.size(); ct++) {
+        android_atomic_acquire_store(0, &objs[ct]->mUserRefCount);
+    }
+    for (size_t ct = 0; ct < objs.size(); ct++) {
+        objs[ct]->decSysRef();
     }
 
     if (rsc->props.mLogObjects) {
@@ -226,15 +236,13 @@ void ObjectBase::freeAllChildren(Context *rsc) {
         ALOGV("Forcing release of all child objects.");
     }
 
-    // This operation can be slow, only to be called during context cleanup.
-    ObjectBase * o = (ObjectBase *)rsc->mObjHead;
-    while (o) {
-        if (o->freeChildren()) {
-            // deleted ref to self and possibly others, restart from head.
-            o = (ObjectBase *)rsc->mObjHead;
-        } else {
-            o = (ObjectBase *)o->mNext;
-        }
+    Vector<const ObjectBase *> objs;
+    pinAll(rsc, &objs);
+    for (size_t ct = 0; ct < objs.size(); ct++) {
+        ((ObjectBase *)objs[ct])->freeChildren();
+    }
+    for (size_t ct = 0; ct < objs.size(); ct++) {
+        objs[ct]->decSysRef();
     }
 
     if (rsc->props.mLogObjects) {
@@ -244,31 +252,109 @@ void ObjectBase::freeAllChildren(Context *rsc) {
 }
 
 void ObjectBase::dumpAll(Context *rsc) {
-    asyncLock();
-
     ALOGV("Dumping all objects");
-    const ObjectBase * o = rsc->mObjHead;
-    while (o) {
-        ALOGV(" Object %p", o);
-        o->dumpLOGV("  ");
-        o = o->mNext;
+    for (uint32_t shard = 0; shard < ObjectRegistry::SHARD_COUNT; shard++) {
+        rsc->mObjects.lockShard(shard);
+        const ObjectBase * o = rsc->mObjects.getHead(shard);
+        while (o) {
+            ALOGV(" Object %p", o);
+            o->dumpLOGV("  ");
+            o = o->mNext;
+        }
+        rsc->mObjects.unlockShard(shard);
     }
+}
 
-    asyncUnlock();
+void ObjectBase::countAll(const Context *rsc, size_t *counts, size_t count) {
+    memset(counts, 0, count * sizeof(size_t));
+
+    for (uint32_t shard = 0; shard < ObjectRegistry::SHARD_COUNT; shard++) {
+        rsc->mObjects.lockShard(shard);
+        const ObjectBase * o = rsc->mObjects.getHead(shard);
+        while (o) {
+            uint32_t id = o->getClassId();
+            if (id < count) {
+                counts[id]++;
+            }
+            o = o->mNext;
+        }
+        rsc->mObjects.unlockShard(shard);
+    }
 }
 
 bool ObjectBase::isValid(const Context *rsc, const ObjectBase *obj) {
-    asyncLock();
+    return rsc->mObjects.contains(obj);
+}
+
+ObjectRegistry::ObjectRegistry() {
+    for (uint32_t ct = 0; ct < SHARD_COUNT; ct++) {
+        pthread_mutex_init(&mShards[ct].lock, NULL);
+        mShards[ct].head = NULL;
+    }
+}
+
+ObjectRegistry::~ObjectRegistry() {
+    for (uint32_t ct = 0; ct < SHARD_COUNT; ct++) {
+        rsAssert(!mShards[ct].head);
+        pthread_mutex_destroy(&mShards[ct].lock);
+    }
+}
+
+uint32_t ObjectRegistry::getShard(const ObjectBase *obj) {
+    uint32_t h = (uint32_t)((uintptr_t)obj >> 4) * 2654435761u;
+    return h >> 28;
+}
+
+// The head of a shard links back to the shard itself, so registered
+// objects always have mPrev set.
+void ObjectRegistry::add(const ObjectBase *obj) {
+    Shard *s = &mShards[getShard(obj)];
+    const ObjectBase *marker = reinterpret_cast<const ObjectBase *>(s);
+
+    pthread_mutex_lock(&s->lock);
+    rsAssert(!obj->mNext);
+    rsAssert(!obj->mPrev);
+    obj->mPrev = marker;
+    obj->mNext = s->head;
+    if (s->head) {
+        s->head->mPrev = obj;
+    }
+    s->head = obj;
+    pthread_mutex_unlock(&s->lock);
+}
+
+void ObjectRegistry::remove(const ObjectBase *obj) {
+    Shard *s = &mShards[getShard(obj)];
+    const ObjectBase *marker = reinterpret_cast<const ObjectBase *>(s);
+
+    pthread_mutex_lock(&s->lock);
+    if (obj->mPrev) {
+        if (obj->mPrev == marker) {
+            s->head = obj->mNext;
+        } else {
+            obj->mPrev->mNext = obj->mNext;
+        }
+        if (obj->mNext) {
+            obj->mNext->mPrev = obj->mPrev;
+        }
+        obj->mPrev = NULL;
+        obj->mNext = NULL;
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+bool ObjectRegistry::contains(const ObjectBase *obj) const {
+    Shard *s = &mShards[getShard(obj)];
+    bool found = false;
 
-    const ObjectBase * o = rsc->mObjHead;
-    while (o) {
+    pthread_mutex_lock(&s->lock);
+    for (const ObjectBase *o = s->head; o; o = o->mNext) {
         if (o == obj) {
-            asyncUnlock();
-            return true;
+            found = true;
+            break;
         }
-        o = o->mNext;
     }
-    asyncUnlock();
-    return false;
+    pthread_mutex_unlock(&s->lock);
+    return found;
 }
 
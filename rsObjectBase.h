@@ -29,6 +29,38 @@ namespace renderscript {
 
 class Context;
 class OStream;
+class ObjectBase;
+
+// Live objects of a context.  Objects are spread over shards by address,
+// each with its own lock and list, so threads creating and destroying
+// objects rarely wait on each other.
+class ObjectRegistry {
+public:
+    static const uint32_t SHARD_COUNT = 16;
+
+    ObjectRegistry();
+    ~ObjectRegistry();
+
+    void add(const ObjectBase *obj);
+    // Does nothing if obj is not registered.
+    void remove(const ObjectBase *obj);
+    bool contains(const ObjectBase *obj) const;
+
+    // Walking a shard needs its lock, unless no other thread can be
+    // creating or destroying objects as during teardown.
+    const ObjectBase * getHead(uint32_t shard) const {return mShards[shard].head;}
+    void lockShard(uint32_t shard) const {pthread_mutex_lock(&mShards[shard].lock);}
+    void unlockShard(uint32_t shard) const {pthread_mutex_unlock(&mShards[shard].lock);}
+
+protected:
+    static uint32_t getShard(const ObjectBase *obj);
+
+    struct Shard {
+        pthread_mutex_t lock;
+        const ObjectBase *head;
+    };
+    mutable Shard mShards[SHARD_COUNT];
+};
 
 // An element is a group of Components that occupies one cell in a structure.
 class ObjectBase {
@@ -37,6 +69,9 @@ public:
 
     void incSysRef() const;
     bool decSysRef() const;
+    // Adds or drops count system references with one atomic update.
+    void incSysRefs(int32_t count) const;
+    bool decSysRefs(int32_t count) const;
 
     void incUserRef() const;
     bool decUserRef() const;
@@ -56,6 +91,8 @@ public:
     static void zeroAllUserRef(Context *rsc);
     static void freeAllChildren(Context *rsc);
     static void dumpAll(Context *rsc);
+    // Counts live objects by RsA3DClassID.
+    static void countAll(const Context *rsc, size_t *counts, size_t count);
 
     virtual void dumpLOGV(const char *prefix) const;
     virtual void serialize(Context *rsc, OStream *stream) const = 0;
@@ -72,13 +109,19 @@ protected:
     // Called inside the async lock for any object list management that is
     // necessary in derived classes.
     virtual void preDestroy() const;
+    // True for objects found through a lookup cache of the context, they
+    // are deleted inside the async lock so a lookup cannot revive them.
+    virtual bool isCached() const {return false;}
 
     Context *mRSC;
     virtual ~ObjectBase();
 
 private:
+    friend class ObjectRegistry;
     static pthread_mutex_t gObjectInitMutex;
 
+    static void pinAll(const Context *rsc, Vector<const ObjectBase *> *objs);
+
     void add() const;
     void remove() const;
 
@@ -86,6 +129,8 @@ private:
     mutable int32_t mSysRefCount;
     mutable int32_t mUserRefCount;
 
+    // Links in the context's ObjectRegistry, mPrev is not NULL while the
+    // object is registered.
     mutable const ObjectBase * mPrev;
     mutable const ObjectBase * mNext;
 
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RS_OBJECT_CACHE_H
+#define ANDROID_RS_OBJECT_CACHE_H
+
+#include "rsUtils.h"
+
+// ---------------------------------------------------------------------------
+namespace android {
+namespace renderscript {
+
+// Hash set of the objects that are shared by structure, such as elements
+// and types.  It is intrusive, T provides mCacheHash, set before add, and
+// a mutable mCacheNext.  Callers hold ObjectBase::asyncLock.
+template <class T>
+class ObjectCache {
+public:
+    ObjectCache() {
+        mBuckets = NULL;
+        mBucketCount = 0;
+        mCount = 0;
+    }
+
+    ~ObjectCache() {
+        free(mBuckets);
+    }
+
+    size_t size() const {return mCount;}
+
+    // First object with the given hash, follow mCacheNext and compare
+    // mCacheHash for the others.
+    T * find(uint32_t hash) const {
+        if (!mBucketCount) {
+            return NULL;
+        }
+        return mBuckets[bucket(hash, mBucketCount)];
+    }
+
+    void add(T *obj) {
+        if (mCount >= mBucketCount) {
+            grow();
+        }
+        T **b = &mBuckets[bucket(obj->mCacheHash, mBucketCount)];
+        obj->mCacheNext = *b;
+        *b = obj;
+        mCount++;
+    }
+
+    void remove(const T *obj) {
+        if (!mBucketCount) {
+            return;
+        }
+        T **b = &mBuckets[bucket(obj->mCacheHash, mBucketCount)];
+        while (*b) {
+            if (*b == obj) {
+                *b = obj->mCacheNext;
+                obj->mCacheNext = NULL;
+                mCount--;
+                return;
+            }
+            b = &(*b)->mCacheNext;
+        }
+    }
+
+protected:
+    static size_t bucket(uint32_t hash, size_t count) {
+        return rsHashFinish(hash) & (count - 1);
+    }
+
+    void grow() {
+        size_t count = mBucketCount ? mBucketCount * 2 : 64;
+        T **buckets = (T **)calloc(count, sizeof(T *));
+        if (!buckets) {
+            // Keep the current table, chains just get longer.
+            if (mBucketCount) {
+                return;
+            }
+            ALOGE("Object cache allocation failed");
+            abort();
+        }
+        for (size_t ct = 0; ct < mBucketCount; ct++) {
+            T *obj = mBuckets[ct];
+            while (obj) {
+                T *next = obj->mCacheNext;
+                T **b = &buckets[bucket(obj->mCacheHash, count)];
+                obj->mCacheNext = *b;
+                *b = obj;
+                obj = next;
+            }
+        }
+        free(mBuckets);
+        mBuckets = buckets;
+        mBucketCount = count;
+    }
+
+    T **mBuckets;
+    size_t mBucketCount;
+    size_t mCount;
+};
+
+}
+}
+#endif //ANDROID_RS_OBJECT_CACHE_H
@@ -55,6 +55,7 @@ public:
                                                          RsCullMode cull);
 protected:
     virtual void preDestroy() const;
+    virtual bool isCached() const {return true;}
     virtual ~ProgramRaster();
 
 private:
@@ -71,6 +71,7 @@ public:
     void init();
 protected:
     virtual void preDestroy() const;
+    virtual bool isCached() const {return true;}
     virtual ~ProgramStore();
 
 private:
@@ -69,6 +69,7 @@ protected:
     int32_t mBoundSlot;
 
     virtual void preDestroy() const;
+    virtual bool isCached() const {return true;}
     virtual ~Sampler();
 
 private:
@@ -124,16 +124,32 @@ RsA3DClassID ScriptFieldID::getClassId() const {
     return RS_A3D_CLASS_ID_SCRIPT_FIELD_ID;
 }
 
+void * ScriptKernelID::operator new(size_t size, Context *rsc) throw() {
+    return rsc->mSlabs.alloc(size);
+}
+
+void ScriptKernelID::operator delete(void *ptr) {
+    SlabHeap::free(ptr);
+}
+
+void * ScriptFieldID::operator new(size_t size, Context *rsc) throw() {
+    return rsc->mSlabs.alloc(size);
+}
+
+void ScriptFieldID::operator delete(void *ptr) {
+    SlabHeap::free(ptr);
+}
+
 
 namespace android {
 namespace renderscript {
 
 RsScriptKernelID rsi_ScriptKernelIDCreate(Context *rsc, RsScript vs, int slot, int sig) {
-    return new ScriptKernelID(rsc, (Script *)vs, slot, sig);
+    return new (rsc) ScriptKernelID(rsc, (Script *)vs, slot, sig);
 }
 
 RsScriptFieldID rsi_ScriptFieldIDCreate(Context *rsc, RsScript vs, int slot) {
-    return new ScriptFieldID(rsc, (Script *)vs, slot);
+    return new (rsc) ScriptFieldID(rsc, (Script *)vs, slot);
 }
 
 void rsi_ScriptBindAllocation(Context * rsc, RsScript vs, RsAllocation va, uint32_t slot) {
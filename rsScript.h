@@ -33,6 +33,9 @@ class ScriptKernelID : public ObjectBase {
 public:
     ScriptKernelID(Context *rsc, Script *s, int slot, int sig);
     virtual ~ScriptKernelID();
+    // Allocated from the context's SlabHeap.
+    static void * operator new(size_t size, Context *rsc) throw();
+    static void operator delete(void *ptr);
 
     virtual void serialize(Context *rsc, OStream *stream) const;
     virtual RsA3DClassID getClassId() const;
@@ -47,6 +50,9 @@ class ScriptFieldID : public ObjectBase {
 public:
     ScriptFieldID(Context *rsc, Script *s, int slot);
     virtual ~ScriptFieldID();
+    // Allocated from the context's SlabHeap.
+    static void * operator new(size_t size, Context *rsc) throw();
+    static void operator delete(void *ptr);
 
     virtual void serialize(Context *rsc, OStream *stream) const;
     virtual RsA3DClassID getClassId() const;
@@ -174,6 +174,97 @@ bool ScriptGroup::calcOrder() {
     return ret;
 }
 
+// Position of k in the order rsdScriptGroupExecute launches kernels:
+// nodes as sorted by calcOrder, then the kernels of each node.
+int ScriptGroup::getExecutionIndex(const ScriptKernelID *k) const {
+    int idx = 0;
+    for (size_t ct=0; ct < mNodes.size(); ct++) {
+        const Node *n = mNodes[ct];
+        for (size_t ct2=0; ct2 < n->mKernels.size(); ct2++) {
+            if (n->mKernels[ct2] == k) {
+                return idx;
+            }
+            idx++;
+        }
+    }
+    return -1;
+}
+
+int ScriptGroup::getExecutionEnd(const Node *node) const {
+    int idx = 0;
+    for (size_t ct=0; ct < mNodes.size(); ct++) {
+        const Node *n = mNodes[ct];
+        idx += n->mKernels.size();
+        if (n == node) {
+            break;
+        }
+    }
+    return idx - 1;
+}
+
+// Intermediates are assigned like registers.  The buffer of a source
+// kernel's links is live from that kernel to the last kernel reading it, a
+// field read counts as every kernel of the reading node, and buffers of the
+// same type are shared between links whose live ranges do not overlap.
+void ScriptGroup::allocateLinks(Context *rsc) {
+    Vector<Allocation *> buffers;
+    Vector<int> lastUse;
+
+    int def = 0;
+    for (size_t ct=0; ct < mNodes.size(); ct++) {
+        const Node *n = mNodes[ct];
+        for (size_t ct2=0; ct2 < n->mKernels.size(); ct2++, def++) {
+            const ScriptKernelID *k = n->mKernels[ct2];
+
+            const Type *type = NULL;
+            int end = def;
+            for (size_t ct3=0; ct3 < n->mOutputs.size(); ct3++) {
+                const Link *l = n->mOutputs[ct3];
+                if (l->mSource.get() != k) {
+                    continue;
+                }
+                if (!type) {
+                    type = l->mType.get();
+                }
+                int use;
+                if (l->mDstKernel.get()) {
+                    use = getExecutionIndex(l->mDstKernel.get());
+                } else {
+                    use = getExecutionEnd(findNode(l->mDstField->mScript));
+                }
+                end = rsMax(end, use);
+            }
+            if (!type) {
+                continue;
+            }
+
+            Allocation *alloc = NULL;
+            for (size_t ct3=0; ct3 < buffers.size(); ct3++) {
+                if ((lastUse[ct3] < def) && (buffers[ct3]->getType() == type)) {
+                    alloc = buffers[ct3];
+                    lastUse.editItemAt(ct3) = end;
+                    break;
+                }
+            }
+            if (!alloc) {
+                alloc = Allocation::createAllocation(rsc, type, RS_ALLOCATION_USAGE_SCRIPT,
+                                                     RS_ALLOCATION_MIPMAP_NONE, NULL,
+                                                     RS_MEMORY_SCRIPT_GROUP);
+                if (alloc) {
+                    buffers.add(alloc);
+                    lastUse.add(end);
+                }
+            }
+
+            for (size_t ct3=0; ct3 < n->mOutputs.size(); ct3++) {
+                if (n->mOutputs[ct3]->mSource.get() == k) {
+                    n->mOutputs[ct3]->mAlloc = alloc;
+                }
+            }
+        }
+    }
+}
+
 ScriptGroup * ScriptGroup::create(Context *rsc,
                            ScriptKernelID ** kernels, size_t kernelsSize,
                            ScriptKernelID ** src, size_t srcSize,
@@ -198,7 +289,7 @@ ScriptGroup * ScriptGroup::create(Context *rsc,
 
     sg->mLinks.reserve(linkCount);
     for (size_t ct=0; ct < linkCount; ct++) {
-        Link *l = new Link();
+        Link *l = new (rsc) Link();
         l->mType = type[ct];
         l->mSource = src[ct];
         l->mDstField = dstF[ct];
@@ -208,27 +299,7 @@ ScriptGroup * ScriptGroup::create(Context *rsc,
 
     sg->calcOrder();
 
-    // allocate links
-    for (size_t ct=0; ct < sg->mNodes.size(); ct++) {
-        const Node *n = sg->mNodes[ct];
-        for (size_t ct2=0; ct2 < n->mOutputs.size(); ct2++) {
-            Link *l = n->mOutputs[ct2];
-            if (l->mAlloc.get()) {
-                continue;
-            }
-            const ScriptKernelID *k = l->mSource.get();
-
-            Allocation * alloc = Allocation::createAllocation(rsc,
-                    l->mType.get(), RS_ALLOCATION_USAGE_SCRIPT);
-            l->mAlloc = alloc;
-
-            for (size_t ct3=ct2+1; ct3 < n->mOutputs.size(); ct3++) {
-                if (n->mOutputs[ct3]->mSource.get() == l->mSource.get()) {
-                    n->mOutputs[ct3]->mAlloc = alloc;
-                }
-            }
-        }
-    }
+    sg->allocateLinks(rsc);
 
     if (rsc->mHal.funcs.scriptgroup.init) {
         rsc->mHal.funcs.scriptgroup.init(rsc, sg);
@@ -326,6 +397,14 @@ ScriptGroup::Link::Link() {
 ScriptGroup::Link::~Link() {
 }
 
+void * ScriptGroup::Link::operator new(size_t size, Context *rsc) throw() {
+    return rsc->mSlabs.alloc(size);
+}
+
+void ScriptGroup::Link::operator delete(void *ptr) {
+    SlabHeap::free(ptr);
+}
+
 namespace android {
 namespace renderscript {
 
@@ -43,6 +43,9 @@ public:
         ObjectBaseRef<Allocation> mAlloc;
         Link();
         ~Link();
+        // Allocated from the context's SlabHeap.
+        static void * operator new(size_t size, Context *rsc) throw();
+        static void operator delete(void *ptr);
     };
 
     class Node {
@@ -103,6 +106,9 @@ private:
     bool calcOrderRecurse(Node *n, int depth);
     bool calcOrder();
     Node * findNode(Script *s) const;
+    int getExecutionIndex(const ScriptKernelID *k) const;
+    int getExecutionEnd(const Node *n) const;
+    void allocateLinks(Context *rsc);
 
     ScriptGroup(Context *);
 };
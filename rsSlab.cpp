@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rsSlab.h"
+
+using namespace android;
+using namespace android::renderscript;
+
+// Precedes every block, the size keeps blocks as aligned as malloc's.
+struct SlabHeader {
+    Slab *slab;
+    SlabHeader *next;
+};
+#define SLAB_HEADER_SIZE 16
+#define SLAB_CHUNK_SIZE (64 * 1024)
+
+namespace android {
+namespace renderscript {
+
+// Blocks of one size, carved from chunks that are kept until the slab goes.
+class Slab {
+public:
+    Slab(size_t size) {
+        pthread_mutex_init(&mLock, NULL);
+        mStride = SLAB_HEADER_SIZE + size;
+        mFree = NULL;
+        mChunks = NULL;
+        mBump = NULL;
+        mBumpEnd = NULL;
+        mLive = 0;
+        mReleased = false;
+    }
+
+    void * alloc() {
+        pthread_mutex_lock(&mLock);
+        SlabHeader *h = mFree;
+        if (h) {
+            mFree = h->next;
+        } else {
+            if ((size_t)(mBumpEnd - mBump) < mStride) {
+                uint8_t *chunk = (uint8_t *)malloc(SLAB_CHUNK_SIZE);
+                if (!chunk) {
+                    pthread_mutex_unlock(&mLock);
+                    return NULL;
+                }
+                *(uint8_t **)chunk = mChunks;
+                mChunks = chunk;
+                mBump = chunk + SLAB_HEADER_SIZE;
+                mBumpEnd = chunk + SLAB_CHUNK_SIZE;
+            }
+            h = (SlabHeader *)mBump;
+            mBump += mStride;
+        }
+        h->slab = this;
+        mLive++;
+        pthread_mutex_unlock(&mLock);
+        return ((uint8_t *)h) + SLAB_HEADER_SIZE;
+    }
+
+    void free(SlabHeader *h) {
+        pthread_mutex_lock(&mLock);
+        h->next = mFree;
+        mFree = h;
+        mLive--;
+        bool done = mReleased && !mLive;
+        pthread_mutex_unlock(&mLock);
+        if (done) {
+            delete this;
+        }
+    }
+
+    // Called when the heap goes away, blocks still out keep the slab.
+    void release() {
+        pthread_mutex_lock(&mLock);
+        mReleased = true;
+        bool done = !mLive;
+        pthread_mutex_unlock(&mLock);
+        if (done) {
+            delete this;
+        }
+    }
+
+private:
+    ~Slab() {
+        while (mChunks) {
+            uint8_t *next = *(uint8_t **)mChunks;
+            ::free(mChunks);
+            mChunks = next;
+        }
+        pthread_mutex_destroy(&mLock);
+    }
+
+    pthread_mutex_t mLock;
+    size_t mStride;
+    SlabHeader *mFree;
+    uint8_t *mChunks;
+    uint8_t *mBump;
+    uint8_t *mBumpEnd;
+    size_t mLive;
+    bool mReleased;
+};
+
+}
+}
+
+SlabHeap::SlabHeap() {
+    for (size_t ct = 0; ct < CLASS_COUNT; ct++) {
+        mSlabs[ct] = new Slab((ct + 1) * CLASS_SIZE);
+    }
+}
+
+SlabHeap::~SlabHeap() {
+    for (size_t ct = 0; ct < CLASS_COUNT; ct++) {
+        mSlabs[ct]->release();
+    }
+}
+
+void * SlabHeap::alloc(size_t size) {
+    size_t idx = size ? (size - 1) / CLASS_SIZE : 0;
+    if (idx < CLASS_COUNT) {
+        return mSlabs[idx]->alloc();
+    }
+
+    SlabHeader *h = (SlabHeader *)malloc(SLAB_HEADER_SIZE + size);
+    if (!h) {
+        return NULL;
+    }
+    h->slab = NULL;
+    return ((uint8_t *)h) + SLAB_HEADER_SIZE;
+}
+
+void SlabHeap::free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    SlabHeader *h = (SlabHeader *)(((uint8_t *)ptr) - SLAB_HEADER_SIZE);
+    if (h->slab) {
+        h->slab->free(h);
+    } else {
+        ::free(h);
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RS_SLAB_H
+#define ANDROID_RS_SLAB_H
+
+#include "rsUtils.h"
+
+// ---------------------------------------------------------------------------
+namespace android {
+namespace renderscript {
+
+class Slab;
+
+// Per context allocator for the small objects that are created and
+// destroyed often, such as allocations, types and their driver state.
+// Requests are rounded up to a size class, each served by its own slab of
+// recycled blocks; larger ones go to malloc.  Blocks carry a header naming
+// their slab so they can be freed without the context, and a slab outlives
+// the heap until its last block is freed.
+class SlabHeap {
+public:
+    static const size_t CLASS_SIZE = 32;
+    static const size_t CLASS_COUNT = 32;
+
+    SlabHeap();
+    ~SlabHeap();
+
+    void * alloc(size_t size);
+    static void free(void *ptr);
+
+private:
+    Slab *mSlabs[CLASS_COUNT];
+};
+
+}
+}
+#endif //ANDROID_RS_SLAB_H
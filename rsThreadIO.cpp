@@ -24,43 +24,160 @@
 
 #include <fcntl.h>
 #include <poll.h>
+#include <time.h>
 
 
 using namespace android;
 using namespace android::renderscript;
 
+static uint64_t getTimeNs() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_nsec + ((uint64_t)t.tv_sec * 1000 * 1000 * 1000);
+}
+
+static uint32_t statsBucket(uint64_t ns, uint32_t bucketCount) {
+    uint64_t us = ns / 1000;
+    if (us == 0) {
+        return 0;
+    }
+    if (us > 0xffffffff) {
+        us = 0xffffffff;
+    }
+    uint32_t b = 32 - __builtin_clz((uint32_t)us);
+    return rsMin(b, bucketCount - 1);
+}
+
+ThreadIO::CoreQueue::CoreQueue(ThreadIO *io) {
+    mIO = io;
+    mSendLen = 0;
+    mFifo.init();
+}
+
+ThreadIO::CoreQueue::~CoreQueue() {
+}
+
 ThreadIO::ThreadIO() {
     mRunning = true;
     mPureFifo = false;
     mMaxInlineSize = 1024;
+    mPlaying = NULL;
+    mStats = NULL;
+    mStatsCount = 0;
+    mStatsEnabled = false;
 }
 
 ThreadIO::~ThreadIO() {
+    free(mStats);
+    for (size_t ct = 0; ct < mQueues.size(); ct++) {
+        delete mQueues[ct];
+    }
 }
 
 void ThreadIO::init() {
     mToClient.init();
-    mToCore.init();
+    mToClientMutex.init();
+    mToCoreWake.init();
+    mQueueMutex.init();
+    pthread_key_create(&mQueueKey, releaseCoreQueue);
+
+    struct pollfd p;
+    p.fd = mToCoreWake.getReadFd();
+    p.events = POLLIN;
+    p.revents = 0;
+    mPollFds.push(p);
 }
 
 void ThreadIO::shutdown() {
+    mQueueMutex.lock();
     mRunning = false;
-    mToCore.shutdown();
+    pthread_key_delete(mQueueKey);
+    mToCoreWake.shutdown();
+    // Release any threads still waiting for a return value.
+    for (size_t ct = 0; ct < mQueues.size(); ct++) {
+        mQueues[ct]->mFifo.shutdown();
+    }
+    mQueueMutex.unlock();
+}
+
+ThreadIO::CoreQueue * ThreadIO::getCoreQueue() {
+    CoreQueue *q = (CoreQueue *)pthread_getspecific(mQueueKey);
+    if (q) {
+        return q;
+    }
+
+    q = new CoreQueue(this);
+    mQueueMutex.lock();
+    mQueues.push(q);
+    mQueueMutex.unlock();
+    pthread_setspecific(mQueueKey, q);
+
+    uint32_t wake = 0;
+    mToCoreWake.writeAsync(&wake, sizeof(wake));
+    return q;
+}
+
+void ThreadIO::releaseCoreQueue(void *vq) {
+    CoreQueue *q = (CoreQueue *)vq;
+    ThreadIO *io = q->mIO;
+
+    // The core thread frees the queue once it reaches this command, after
+    // everything the exiting thread submitted before it.
+    io->mQueueMutex.lock();
+    if (io->mRunning) {
+        CoreCmdHeader hdr;
+        hdr.cmdID = CORE_CMD_RELEASE_QUEUE;
+        hdr.bytes = 0;
+        q->mFifo.writeAsync(&hdr, sizeof(hdr));
+    }
+    io->mQueueMutex.unlock();
+}
+
+void ThreadIO::updateCoreQueues() {
+    mQueueMutex.lock();
+    mPlayQueues = mQueues;
+    mQueueMutex.unlock();
+
+    mPollFds.setCapacity(mPlayQueues.size() + 2);
+    mPollFds.resize(1);
+    for (size_t ct = 0; ct < mPlayQueues.size(); ct++) {
+        struct pollfd p;
+        p.fd = mPlayQueues[ct]->mFifo.getReadFd();
+        p.events = POLLIN;
+        p.revents = 0;
+        mPollFds.push(p);
+    }
+}
+
+void ThreadIO::removeCoreQueue(CoreQueue *q) {
+    mQueueMutex.lock();
+    for (size_t ct = 0; ct < mQueues.size(); ct++) {
+        if (mQueues[ct] == q) {
+            mQueues.removeAt(ct);
+            break;
+        }
+    }
+    mQueueMutex.unlock();
+
+    q->mFifo.shutdown();
+    delete q;
 }
 
 void * ThreadIO::coreHeader(uint32_t cmdID, size_t dataLen) {
     //ALOGE("coreHeader %i %i", cmdID, dataLen);
-    CoreCmdHeader *hdr = (CoreCmdHeader *)&mSendBuffer[0];
+    CoreQueue *q = getCoreQueue();
+    CoreCmdHeader *hdr = (CoreCmdHeader *)&q->mSendBuffer[0];
     hdr->bytes = dataLen;
     hdr->cmdID = cmdID;
-    mSendLen = dataLen + sizeof(CoreCmdHeader);
-    //mToCoreSocket.writeAsync(&hdr, sizeof(hdr));
+    hdr->queueTime = mStatsEnabled ? getTimeNs() : 0;
+    q->mSendLen = dataLen + sizeof(CoreCmdHeader);
     //ALOGE("coreHeader ret ");
-    return &mSendBuffer[sizeof(CoreCmdHeader)];
+    return &q->mSendBuffer[sizeof(CoreCmdHeader)];
 }
 
 void ThreadIO::coreCommit() {
-    mToCore.writeAsync(&mSendBuffer, mSendLen);
+    CoreQueue *q = getCoreQueue();
+    q->mFifo.writeAsync(&q->mSendBuffer, q->mSendLen);
 }
 
 void ThreadIO::clientShutdown() {
@@ -69,12 +186,12 @@ void ThreadIO::clientShutdown() {
 
 void ThreadIO::coreWrite(const void *data, size_t len) {
     //ALOGV("core write %p %i", data, (int)len);
-    mToCore.writeAsync(data, len, true);
+    getCoreQueue()->mFifo.writeAsync(data, len, true);
 }
 
 void ThreadIO::coreRead(void *data, size_t len) {
     //ALOGV("core read %p %i", data, (int)len);
-    mToCore.read(data, len);
+    mPlaying->mFifo.read(data, len);
 }
 
 void ThreadIO::coreSetReturn(const void *data, size_t dataLen) {
@@ -84,7 +201,7 @@ void ThreadIO::coreSetReturn(const void *data, size_t dataLen) {
         dataLen = sizeof(buf);
     }
 
-    mToCore.readReturn(data, dataLen);
+    mPlaying->mFifo.readReturn(data, dataLen);
 }
 
 void ThreadIO::coreGetReturn(void *data, size_t dataLen) {
@@ -94,13 +211,115 @@ void ThreadIO::coreGetReturn(void *data, size_t dataLen) {
         dataLen = sizeof(buf);
     }
 
-    mToCore.writeWaitReturn(data, dataLen);
+    getCoreQueue()->mFifo.writeWaitReturn(data, dataLen);
 }
 
 void ThreadIO::setTimeoutCallback(void (*cb)(void *), void *dat, uint64_t timeout) {
     //mToCore.setTimeoutCallback(cb, dat, timeout);
 }
 
+void ThreadIO::playCommand(Context *con, const CoreCmdHeader *cmd,
+                           const void *data, bool isLocal) {
+    if (isLocal) {
+        gPlaybackFuncs[cmd->cmdID](con, data, cmd->bytes);
+    } else {
+        gPlaybackRemoteFuncs[cmd->cmdID](con, this);
+    }
+}
+
+void ThreadIO::setCommandStats(bool enable) {
+    if (!enable) {
+        // Keep what was collected so it can still be read.
+        mStatsEnabled = false;
+        return;
+    }
+
+    if (!mStats) {
+        mStats = (RsCommandStats *)calloc(sizeof(gPlaybackFuncs) / sizeof(void *),
+                                          sizeof(RsCommandStats));
+        if (!mStats) {
+            ALOGE("Unable to allocate command stats");
+            return;
+        }
+        mStatsCount = sizeof(gPlaybackFuncs) / sizeof(void *);
+    } else {
+        memset(mStats, 0, mStatsCount * sizeof(RsCommandStats));
+    }
+    mStatsEnabled = true;
+}
+
+uint32_t ThreadIO::getCommandStats(RsCommandStats *stats, uint32_t count) const {
+    const uint32_t total = sizeof(gPlaybackFuncs) / sizeof(void *);
+    count = rsMin(count, total);
+    for (uint32_t ct = 0; ct < count; ct++) {
+        if (mStats) {
+            stats[ct] = mStats[ct];
+        } else {
+            memset(&stats[ct], 0, sizeof(stats[ct]));
+        }
+        stats[ct].name = gPlaybackNames[ct];
+    }
+    return total;
+}
+
+uint64_t ThreadIO::commandStart() const {
+    return mStatsEnabled ? getTimeNs() : 0;
+}
+
+void ThreadIO::commandEnd(uint32_t cmdID, uint64_t start) {
+    if (start) {
+        recordCommand(cmdID, 0, start, getTimeNs());
+    }
+}
+
+void ThreadIO::recordCommand(uint32_t cmdID, uint64_t queueTime,
+                             uint64_t start, uint64_t end) {
+    // The command itself may have turned stats off.
+    if (!mStatsEnabled || (cmdID >= mStatsCount)) {
+        return;
+    }
+
+    RsCommandStats *s = &mStats[cmdID];
+    s->count++;
+    s->execTotal += end - start;
+    s->execHist[statsBucket(end - start, RS_COMMAND_STATS_BUCKETS)]++;
+    // Commands queued before stats were enabled carry no timestamp.
+    if (queueTime && (queueTime <= start)) {
+        s->waitTotal += start - queueTime;
+        s->waitHist[statsBucket(start - queueTime, RS_COMMAND_STATS_BUCKETS)]++;
+    }
+}
+
+void ThreadIO::dumpCommandStats() const {
+    if (!mStats) {
+        return;
+    }
+
+    ALOGV("Command stats, histogram bucket n holds [2^(n-1), 2^n) us");
+    for (size_t ct = 0; ct < mStatsCount; ct++) {
+        const RsCommandStats *s = &mStats[ct];
+        if (!s->count) {
+            continue;
+        }
+        ALOGV(" %s count %u, avg wait %llu us, avg exec %llu us", gPlaybackNames[ct], s->count,
+              (unsigned long long)(s->waitTotal / s->count / 1000),
+              (unsigned long long)(s->execTotal / s->count / 1000));
+
+        String8 wait("  wait");
+        String8 exec("  exec");
+        for (uint32_t b = 0; b < RS_COMMAND_STATS_BUCKETS; b++) {
+            if (s->waitHist[b]) {
+                wait.appendFormat(" [%u]=%u", b, s->waitHist[b]);
+            }
+            if (s->execHist[b]) {
+                exec.appendFormat(" [%u]=%u", b, s->execHist[b]);
+            }
+        }
+        ALOGV("%s", wait.string());
+        ALOGV("%s", exec.string());
+    }
+}
+
 bool ThreadIO::playCoreCommands(Context *con, int waitFd) {
     bool ret = false;
     const bool isLocal = !isPureFifo();
@@ -109,44 +328,76 @@ bool ThreadIO::playCoreCommands(Context *con, int waitFd) {
     const CoreCmdHeader *cmd = (const CoreCmdHeader *)&buf[0];
     const void * data = (const void *)&buf[sizeof(CoreCmdHeader)];
 
-    struct pollfd p[2];
-    p[0].fd = mToCore.getReadFd();
-    p[0].events = POLLIN;
-    p[0].revents = 0;
-    p[1].fd = waitFd;
-    p[1].events = POLLIN;
-    p[1].revents = 0;
-    int pollCount = 1;
-    if (waitFd >= 0) {
-        pollCount = 2;
-    }
-
     if (con->props.mLogTimes) {
         con->timerSet(Context::RS_TIMER_IDLE);
     }
 
     int waitTime = -1;
     while (mRunning) {
-        int pr = poll(p, pollCount, waitTime);
-        if (pr <= 0) {
+        // Slot 0 is the wake socket, then one slot per queue and the
+        // optional secondary wait object last.
+        const size_t queueCount = mPlayQueues.size();
+        size_t pollCount = queueCount + 1;
+        if (waitFd >= 0) {
+            struct pollfd p;
+            p.fd = waitFd;
+            p.events = POLLIN;
+            p.revents = 0;
+            mPollFds.push(p);
+            pollCount++;
+        }
+
+        // With objects waiting to be destroyed only check for commands, and
+        // reclaim a batch if there are none.
+        int pollTime = con->hasDeferredDestroys() ? 0 : waitTime;
+        int pr = poll(mPollFds.editArray(), pollCount, pollTime);
+        bool waitFdReady = (waitFd >= 0) && mPollFds[queueCount + 1].revents;
+        bool wakeReady = mPollFds[0].revents != 0;
+        if (waitFd >= 0) {
+            mPollFds.removeAt(queueCount + 1);
+        }
+        if ((pr == 0) && con->hasDeferredDestroys()) {
+            con->reclaimDeferred(RS_DEFERRED_DESTROY_BATCH);
+            if (waitTime && mRunning) {
+                continue;
+            }
+        }
+        if (pr <= 0 || !mRunning) {
             break;
         }
 
-        if (p[0].revents) {
+        // Service at most one command per queue per pass so a busy thread
+        // cannot starve the others.
+        bool processed = false;
+        for (size_t ct = 0; ct < queueCount; ct++) {
+            if (!mPollFds[ct + 1].revents) {
+                continue;
+            }
+            mPlaying = mPlayQueues[ct];
+
             size_t r = 0;
             if (isLocal) {
-                r = mToCore.read(&buf[0], sizeof(CoreCmdHeader));
-                mToCore.read(&buf[sizeof(CoreCmdHeader)], cmd->bytes);
+                r = mPlaying->mFifo.read(&buf[0], sizeof(CoreCmdHeader));
                 if (r != sizeof(CoreCmdHeader)) {
                     // exception or timeout occurred.
-                    break;
+                    mPlaying = NULL;
+                    return ret;
                 }
+                mPlaying->mFifo.read(&buf[sizeof(CoreCmdHeader)], cmd->bytes);
             } else {
-                r = mToCore.read((void *)&cmd->cmdID, sizeof(cmd->cmdID));
+                r = mPlaying->mFifo.read((void *)&cmd->cmdID, sizeof(cmd->cmdID));
             }
 
+            if (cmd->cmdID == CORE_CMD_RELEASE_QUEUE) {
+                // The producer thread exited; nothing else will arrive here.
+                removeCoreQueue(mPlaying);
+                mPlaying = NULL;
+                wakeReady = true;
+                continue;
+            }
 
             ret = true;
+            processed = true;
             if (con->props.mLogTimes) {
                 con->timerSet(Context::RS_TIMER_INTERNAL);
             }
@@ -157,24 +408,35 @@ bool ThreadIO::playCoreCommands(Context *con, int waitFd) {
                 ALOGE("playCoreCommands error con %p, cmd %i", con, cmd->cmdID);
             }
 
-            if (isLocal) {
-                gPlaybackFuncs[cmd->cmdID](con, data, cmd->bytes);
+            if (mStatsEnabled) {
+                uint64_t start = getTimeNs();
+                playCommand(con, cmd, data, isLocal);
+                recordCommand(cmd->cmdID, isLocal ? cmd->queueTime : 0, start, getTimeNs());
             } else {
-                gPlaybackRemoteFuncs[cmd->cmdID](con, this);
+                playCommand(con, cmd, data, isLocal);
             }
+            mPlaying = NULL;
 
             if (con->props.mLogTimes) {
                 con->timerSet(Context::RS_TIMER_IDLE);
             }
+        }
 
-            if (waitFd < 0) {
-                // If we don't have a secondary wait object we should stop blocking now
-                // that at least one command has been processed.
-                waitTime = 0;
+        if (wakeReady) {
+            if (mPollFds[0].revents) {
+                uint32_t wake;
+                mToCoreWake.read(&wake, sizeof(wake));
             }
+            updateCoreQueues();
         }
 
-        if (p[1].revents && !p[0].revents) {
+        if (processed && (waitFd < 0)) {
+            // If we don't have a secondary wait object we should stop blocking now
+            // that at least one command has been processed.
+            waitTime = 0;
+        }
+
+        if (waitFdReady && !processed) {
             // We want to finish processing fifo events before processing the vsync.
             // Otherwise we can end up falling behind and having tremendous lag.
             break;
@@ -208,6 +470,47 @@ RsMessageToClientType ThreadIO::getClientPayload(void *data, size_t *receiveLen,
     return (RsMessageToClientType)mLastClientHeader.cmdID;
 }
 
+RsMessageToClientType ThreadIO::getClientMessages(void *data, size_t bufferLen,
+                                                  size_t *receiveLen, uint32_t *count) {
+    uint8_t *out = (uint8_t *)data;
+    size_t used = 0;
+    uint32_t ct = 0;
+
+    // Block for the first message only, then drain whatever else is ready.
+    while ((ct == 0) || !mToClient.isEmpty()) {
+        ClientCmdHeader hdr;
+        if (mToClient.peek(&hdr, sizeof(hdr)) != sizeof(hdr)) {
+            break;
+        }
+
+        size_t stride = (sizeof(RsMessageToClientHeader) + hdr.bytes + 7) & ~7;
+        if ((used + stride) > bufferLen) {
+            if (ct == 0) {
+                receiveLen[0] = stride;
+                count[0] = 0;
+                return RS_MESSAGE_TO_CLIENT_RESIZE;
+            }
+            break;
+        }
+
+        mToClient.read(&hdr, sizeof(hdr));
+        RsMessageToClientHeader *msg = (RsMessageToClientHeader *)&out[used];
+        msg->msgType = hdr.cmdID;
+        msg->userID = hdr.userID;
+        msg->bytes = hdr.bytes;
+        msg->stride = stride;
+        if (hdr.bytes) {
+            mToClient.read(&msg[1], hdr.bytes);
+        }
+        used += stride;
+        ct++;
+    }
+
+    receiveLen[0] = used;
+    count[0] = ct;
+    return RS_MESSAGE_TO_CLIENT_NONE;
+}
+
 bool ThreadIO::sendToClient(RsMessageToClientType cmdID, uint32_t usrID, const void *data,
                             size_t dataLen, bool waitForSpace) {
 
@@ -217,10 +520,9 @@ bool ThreadIO::sendToClient(RsMessageToClientType cmdID, uint32_t usrID, const v
     hdr.cmdID = cmdID;
     hdr.userID = usrID;
 
-    mToClient.writeAsync(&hdr, sizeof(hdr));
-    if (dataLen) {
-        mToClient.writeAsync(data, dataLen);
-    }
+    mToClientMutex.lock();
+    mToClient.writeMessageAsync(&hdr, sizeof(hdr), data, dataLen);
+    mToClientMutex.unlock();
 
     //ALOGE("sendToClient x");
     return true;
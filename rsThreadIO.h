@@ -18,7 +18,11 @@
 #define ANDROID_RS_THREAD_IO_H
 
 #include "rsUtils.h"
+#include "rsMutex.h"
 #include "rsFifoSocket.h"
+#include "rsDefines.h"
+
+#include <poll.h>
 
 // ---------------------------------------------------------------------------
 namespace android {
@@ -47,6 +51,19 @@ public:
 
     void setTimeoutCallback(void (*)(void *), void *, uint64_t timeout);
 
+    // Per command counts and latency histograms.  Only called by the thread
+    // playing commands, which for synchronous contexts is a caller thread
+    // holding the sync lock.
+    void setCommandStats(bool enable);
+    uint32_t getCommandStats(RsCommandStats *stats, uint32_t count) const;
+    void dumpCommandStats() const;
+    bool commandStatsEnabled() const {
+        return mStatsEnabled;
+    }
+    // Times a command run directly by a synchronous context.
+    uint64_t commandStart() const;
+    void commandEnd(uint32_t cmdID, uint64_t start);
+
     void * coreHeader(uint32_t, size_t dataLen);
     void coreCommit();
 
@@ -63,6 +80,8 @@ public:
 
     RsMessageToClientType getClientHeader(size_t *receiveLen, uint32_t *usrID);
     RsMessageToClientType getClientPayload(void *data, size_t *receiveLen, uint32_t *subID, size_t bufferLen);
+    RsMessageToClientType getClientMessages(void *data, size_t bufferLen,
+                                            size_t *receiveLen, uint32_t *count);
     bool sendToClient(RsMessageToClientType cmdID, uint32_t usrID, const void *data, size_t dataLen, bool waitForSpace);
     void clientShutdown();
 
@@ -71,7 +90,44 @@ protected:
     typedef struct CoreCmdHeaderRec {
         uint32_t cmdID;
         uint32_t bytes;
+        // Submission time, only set while command stats are enabled.
+        uint64_t queueTime;
     } CoreCmdHeader;
+
+    // Command id 0 is never assigned to an API. It is sent by a producer
+    // thread as the last command on its queue when the thread exits.
+    static const uint32_t CORE_CMD_RELEASE_QUEUE = 0;
+
+    // Each thread submitting commands gets its own queue to the core.
+    // Commands from one thread stay in order, commands from different threads
+    // are interleaved by the core thread.  Submitting only touches the
+    // calling thread's queue so no lock is needed after the first call.
+    class CoreQueue {
+    public:
+        CoreQueue(ThreadIO *io);
+        ~CoreQueue();
+
+        ThreadIO *mIO;
+        FifoSocket mFifo;
+        size_t mSendLen;
+        uint8_t mSendBuffer[2 * 1024] __attribute__((aligned(sizeof(double))));
+    };
+
+    // Allocated the first time stats are enabled and kept until the
+    // ThreadIO is destroyed, so that submitting threads only ever look at
+    // mStatsEnabled.
+    RsCommandStats *mStats;
+    size_t mStatsCount;
+    volatile bool mStatsEnabled;
+
+    void playCommand(Context *con, const CoreCmdHeader *cmd, const void *data, bool isLocal);
+    void recordCommand(uint32_t cmdID, uint64_t queueTime, uint64_t start, uint64_t end);
+
+    CoreQueue * getCoreQueue();
+    static void releaseCoreQueue(void *);
+    void updateCoreQueues();
+    void removeCoreQueue(CoreQueue *);
+
     typedef struct ClientCmdHeaderRec {
         uint32_t cmdID;
         uint32_t bytes;
@@ -84,13 +140,21 @@ protected:
     size_t mMaxInlineSize;
 
     FifoSocket mToClient;
-    FifoSocket mToCore;
+    // Kernels on the worker threads may send concurrently.
+    Mutex mToClientMutex;
 
-    intptr_t mToCoreRet;
+    // Wakes the core thread when queues are added or on shutdown.
+    FifoSocket mToCoreWake;
 
-    size_t mSendLen;
-    uint8_t mSendBuffer[2 * 1024] __attribute__((aligned(sizeof(double))));
+    pthread_key_t mQueueKey;
+    Mutex mQueueMutex;
+    // Guarded by mQueueMutex.
+    Vector<CoreQueue *> mQueues;
 
+    // Only accessed by the core thread.
+    Vector<CoreQueue *> mPlayQueues;
+    Vector<struct pollfd> mPollFds;
+    CoreQueue *mPlaying;
 };
 
 
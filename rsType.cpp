@@ -22,15 +22,12 @@ using namespace android::renderscript;
 Type::Type(Context *rsc) : ObjectBase(rsc) {
     memset(&mHal, 0, sizeof(mHal));
     mDimLOD = false;
+    mCacheHash = 0;
+    mCacheNext = NULL;
 }
 
 void Type::preDestroy() const {
-    for (uint32_t ct = 0; ct < mRSC->mStateType.mTypes.size(); ct++) {
-        if (mRSC->mStateType.mTypes[ct] == this) {
-            mRSC->mStateType.mTypes.removeAt(ct);
-            break;
-        }
-    }
+    mRSC->mStateType.mTypes.remove(this);
 }
 
 Type::~Type() {
@@ -40,14 +37,19 @@ Type::~Type() {
 void Type::clear() {
     if (mHal.state.lodCount) {
         delete [] mHal.state.lodDimX;
-        delete [] mHal.state.lodDimY;
-        delete [] mHal.state.lodDimZ;
-        delete [] mHal.state.lodOffset;
     }
     mElement.clear();
     memset(&mHal, 0, sizeof(mHal));
 }
 
+void * Type::operator new(size_t size, Context *rsc) throw() {
+    return rsc->mSlabs.alloc(size);
+}
+
+void Type::operator delete(void *ptr) {
+    SlabHeap::free(ptr);
+}
+
 TypeState::TypeState() {
 }
 
@@ -75,14 +77,13 @@ void Type::compute() {
     if (mHal.state.lodCount != oldLODCount) {
         if (oldLODCount) {
             delete [] mHal.state.lodDimX;
-            delete [] mHal.state.lodDimY;
-            delete [] mHal.state.lodDimZ;
-            delete [] mHal.state.lodOffset;
         }
-        mHal.state.lodDimX = new uint32_t[mHal.state.lodCount];
-        mHal.state.lodDimY = new uint32_t[mHal.state.lodCount];
-        mHal.state.lodDimZ = new uint32_t[mHal.state.lodCount];
-        mHal.state.lodOffset = new uint32_t[mHal.state.lodCount];
+        // The four LOD arrays share one block, owned through lodDimX.
+        uint32_t *lods = new uint32_t[mHal.state.lodCount * 4];
+        mHal.state.lodDimX = lods;
+        mHal.state.lodDimY = lods + mHal.state.lodCount;
+        mHal.state.lodDimZ = lods + mHal.state.lodCount * 2;
+        mHal.state.lodOffset = lods + mHal.state.lodCount * 3;
     }
 
     uint32_t tx = mHal.state.dimX;
@@ -215,16 +216,26 @@ bool Type::getIsNp2() const {
     return false;
 }
 
+uint32_t Type::hashKey(const Element *e, uint32_t dimX, uint32_t dimY, uint32_t dimZ,
+                       bool dimLOD, bool dimFaces) {
+    uint32_t hash = rsHashPtr(RS_HASH_SEED, e);
+    hash = rsHashMix(hash, dimX);
+    hash = rsHashMix(hash, dimY);
+    hash = rsHashMix(hash, dimZ);
+    return rsHashMix(hash, (dimLOD ? 1 : 0) | (dimFaces ? 2 : 0));
+}
+
 ObjectBaseRef<Type> Type::getTypeRef(Context *rsc, const Element *e,
                                      uint32_t dimX, uint32_t dimY, uint32_t dimZ,
                                      bool dimLOD, bool dimFaces) {
     ObjectBaseRef<Type> returnRef;
+    uint32_t hash = hashKey(e, dimX, dimY, dimZ, dimLOD, dimFaces);
 
     TypeState * stc = &rsc->mStateType;
 
     ObjectBase::asyncLock();
-    for (uint32_t ct=0; ct < stc->mTypes.size(); ct++) {
-        Type *t = stc->mTypes[ct];
+    for (Type *t = stc->mTypes.find(hash); t; t = t->mCacheNext) {
+        if (t->mCacheHash != hash) continue;
         if (t->getElement() != e) continue;
         if (t->getDimX() != dimX) continue;
         if (t->getDimY() != dimY) continue;
@@ -238,7 +249,11 @@ ObjectBaseRef<Type> Type::getTypeRef(Context *rsc, const Element *e,
     ObjectBase::asyncUnlock();
 
 
-    Type *nt = new Type(rsc);
+    Type *nt = new (rsc) Type(rsc);
+    if (!nt) {
+        rsc->setError(RS_ERROR_OUT_OF_MEMORY, "Type object allocation failed");
+        return returnRef;
+    }
     nt->mDimLOD = dimLOD;
     returnRef.set(nt);
     nt->mElement.set(e);
@@ -247,9 +262,10 @@ ObjectBaseRef<Type> Type::getTypeRef(Context *rsc, const Element *e,
     nt->mHal.state.dimZ = dimZ;
     nt->mHal.state.faces = dimFaces;
     nt->compute();
+    nt->mCacheHash = hash;
 
     ObjectBase::asyncLock();
-    stc->mTypes.push(nt);
+    stc->mTypes.add(nt);
     ObjectBase::asyncUnlock();
 
     return returnRef;
@@ -269,33 +285,20 @@ ObjectBaseRef<Type> Type::cloneAndResize2D(Context *rsc,
 
 
 void Type::incRefs(const void *ptr, size_t ct, size_t startOff) const {
-    const uint8_t *p = static_cast<const uint8_t *>(ptr);
     const Element *e = mHal.state.element;
-    uint32_t stride = e->getSizeBytes();
-
-    p += stride * startOff;
-    while (ct > 0) {
-        e->incRefs(p);
-        ct--;
-        p += stride;
+    if (!e->getHasReferences()) {
+        return;
     }
+    e->incRefs(static_cast<const uint8_t *>(ptr) + e->getSizeBytes() * startOff, ct);
 }
 
 
 void Type::decRefs(const void *ptr, size_t ct, size_t startOff) const {
-    if (!mHal.state.element->getHasReferences()) {
-        return;
-    }
-    const uint8_t *p = static_cast<const uint8_t *>(ptr);
     const Element *e = mHal.state.element;
-    uint32_t stride = e->getSizeBytes();
-
-    p += stride * startOff;
-    while (ct > 0) {
-        e->decRefs(p);
-        ct--;
-        p += stride;
+    if (!e->getHasReferences()) {
+        return;
     }
+    e->decRefs(static_cast<const uint8_t *>(ptr) + e->getSizeBytes() * startOff, ct);
 }
 
 
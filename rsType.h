@@ -137,8 +137,20 @@ protected:
 
     size_t mMipChainSizeBytes;
     size_t mTotalSizeBytes;
+
+    // Identity in TypeState's cache.
+    friend class ObjectCache<Type>;
+    static uint32_t hashKey(const Element *e, uint32_t dimX, uint32_t dimY, uint32_t dimZ,
+                            bool dimLOD, bool dimFaces);
+    uint32_t mCacheHash;
+    mutable Type *mCacheNext;
+
+    // Allocated from the context's SlabHeap.
+    static void * operator new(size_t size, Context *rsc) throw();
+    static void operator delete(void *ptr);
 protected:
     virtual void preDestroy() const;
+    virtual bool isCached() const {return true;}
     virtual ~Type();
 
 private:
@@ -152,8 +164,8 @@ public:
     TypeState();
     ~TypeState();
 
-    // Cache of all existing types.
-    Vector<Type *> mTypes;
+    // Cache of all existing types, keyed on their structure.
+    ObjectCache<Type> mTypes;
 };
 
 
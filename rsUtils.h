@@ -114,6 +114,37 @@ static inline uint32_t rsBoxFilter8888(uint32_t i1, uint32_t i2, uint32_t i3, ui
     return (r >> 2) | ((g >> 2) << 8) | ((b >> 2) << 16) | ((a >> 2) << 24);
 }
 
+// FNV-1a style mixing, used to key the object caches.
+#define RS_HASH_SEED 2166136261u
+
+static inline uint32_t rsHashMix(uint32_t hash, uint32_t v) {
+    return (hash ^ v) * 16777619u;
+}
+
+// Spreads every bit of the hash over all the others, the mixing above
+// only carries low bits upwards and tables index with the low bits.
+static inline uint32_t rsHashFinish(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static inline uint32_t rsHashPtr(uint32_t hash, const void *p) {
+    uint64_t v = (uintptr_t)p;
+    return rsHashMix(rsHashMix(hash, (uint32_t)v), (uint32_t)(v >> 32));
+}
+
+static inline uint32_t rsHashBytes(uint32_t hash, const void *p, size_t len) {
+    const uint8_t *b = static_cast<const uint8_t *>(p);
+    for (size_t ct = 0; ct < len; ct++) {
+        hash = rsHashMix(hash, b[ct]);
+    }
+    return hash;
+}
+
 }
 }
 
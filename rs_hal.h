@@ -86,6 +86,11 @@ typedef struct {
     void (*shutdownDriver)(Context *);
     void (*getVersion)(unsigned int *major, unsigned int *minor);
     void (*setPriority)(const Context *, int32_t priority);
+    // Prepare the calling thread to execute commands for the context.
+    // Used by synchronous contexts which do not run on the context thread.
+    void (*attachThread)(const Context *);
+    // Log driver state and statistics, called from ContextDump.
+    void (*dump)(const Context *);
 
 
 
@@ -141,7 +146,7 @@ typedef struct {
         bool (*init)(const Context *rsc, Allocation *alloc, bool forceZero);
         void (*destroy)(const Context *rsc, Allocation *alloc);
 
-        void (*resize)(const Context *rsc, const Allocation *alloc, const Type *newType,
+        bool (*resize)(const Context *rsc, const Allocation *alloc, const Type *newType,
                        bool zeroNew);
         void (*syncAll)(const Context *rsc, const Allocation *alloc, RsAllocationUsageType src);
         void (*markDirty)(const Context *rsc, const Allocation *alloc);
@@ -208,6 +213,21 @@ typedef struct {
                               const void *data, uint32_t elementOff, size_t sizeBytes);
 
         void (*generateMipmaps)(const Context *rsc, const Allocation *alloc);
+
+        // The driver may keep the storage of destroyed allocations for
+        // reuse.  setPoolLimit bounds the bytes kept, trimPool releases
+        // storage until at most bytes are kept.
+        void (*setPoolLimit)(const Context *rsc, size_t bytes);
+        void (*trimPool)(const Context *rsc, size_t bytes);
+
+        // Like init, but the storage is the type's size in bytes of fd
+        // starting at offset, laid out without row padding.
+        bool (*initFromFile)(const Context *rsc, Allocation *alloc, int fd, size_t offset);
+
+        // Like init, with storage holding a copy of src's current contents
+        // in the same layout.  Later writes to either are not seen by the
+        // other.
+        bool (*initSnapshot)(const Context *rsc, Allocation *alloc, const Allocation *src);
     } allocation;
 
     struct {
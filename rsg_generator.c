@@ -181,6 +181,231 @@ static int hasInlineDataPointers(const ApiEntry * api) {
     return ret;
 }
 
+static void printCallArgs(FILE *f, const ApiEntry *api, const char *con, const char *prefix) {
+    int ct;
+    fprintf(f, "(");
+    if (!api->nocontext) {
+        fprintf(f, "%s", con);
+    }
+    for (ct=0; ct < api->paramCount; ct++) {
+        const VarType *vt = &api->params[ct];
+        if (ct > 0 || !api->nocontext) {
+            fprintf(f, ", ");
+        }
+        fprintf(f, "%s%s", prefix, vt->name);
+    }
+    fprintf(f, ");\n");
+}
+
+static void printDirectCall(FILE *f, const ApiEntry *api) {
+    if (api->ret.typeName[0]) {
+        fprintf(f, "return ");
+    }
+    fprintf(f, "rsi_%s", api->name);
+    printCallArgs(f, api, "(Context *)rsc", "");
+}
+
+static int isObjectType(const VarType *vt) {
+    static const char * objectTypes[] = {
+        "RsAllocation", "RsAsyncVoidPtr", "RsElement", "RsFont", "RsMesh",
+        "RsObjectBase", "RsPath", "RsProgram", "RsProgramFragment",
+        "RsProgramRaster", "RsProgramStore", "RsProgramVertex", "RsSampler",
+        "RsScript", "RsScriptFieldID", "RsScriptGroup", "RsScriptKernelID",
+        "RsType", NULL
+    };
+    int ct;
+    for (ct=0; objectTypes[ct]; ct++) {
+        if (!strcmp(vt->typeName, objectTypes[ct])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// The client message APIs run on the application's message thread, context
+// teardown is done by the replay tool itself and native windows cannot be
+// recreated, so none of these are captured.
+static int isCaptured(const ApiEntry *api) {
+    static const char * skipped[] = {
+        "ContextDestroy", "ContextDestroyWorker", "ContextGetMessage",
+        "ContextPeekMessage", "ContextGetMessages", "ContextInitToClient",
+        "ContextDeinitToClient", "AllocationGetSurfaceTextureID2", NULL
+    };
+    int ct;
+    if (api->nocontext) {
+        return 0;
+    }
+    for (ct=0; skipped[ct]; ct++) {
+        if (!strcmp(api->name, skipped[ct])) {
+            return 0;
+        }
+    }
+    for (ct=0; ct < api->paramCount; ct++) {
+        if (!strcmp(api->params[ct].typeName, "RsNativeWindow")) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Single level pointers whose contents are recorded.  Only untyped non-const
+// buffers are treated as outputs.
+static int isCapturedInput(const VarType *vt) {
+    return (vt->ptrLevel == 1) &&
+           (vt->isConst || isObjectType(vt) || strcmp(vt->typeName, "void"));
+}
+
+static void printCaptureFuncs(FILE *f) {
+    int ct;
+    int ct2;
+
+    for (ct=0; ct < apiCount; ct++) {
+        const ApiEntry * api = &apis[ct];
+        if (!isCaptured(api)) {
+            continue;
+        }
+
+        fprintf(f, "static ");
+        printFuncDecl(f, api, "CF_", 0, 0);
+        fprintf(f, "\n{\n");
+        fprintf(f, "    Capture *cap = ((Context *)rsc)->mCapture;\n");
+        fprintf(f, "    if (!cap || !cap->beginCommand(RS_CMD_ID_%s)) {\n", api->name);
+        fprintf(f, "        ");
+        if (api->ret.typeName[0]) {
+            fprintf(f, "return ");
+        }
+        fprintf(f, "LF_%s", api->name);
+        printCallArgs(f, api, "rsc", "");
+        if (!api->ret.typeName[0]) {
+            fprintf(f, "        return;\n");
+        }
+        fprintf(f, "    }\n\n");
+
+        for (ct2=0; ct2 < api->paramCount; ct2++) {
+            const VarType *vt = &api->params[ct2];
+            if (vt->ptrLevel == 0) {
+                fprintf(f, "    cap->write(&%s, sizeof(%s));\n", vt->name, vt->name);
+            }
+        }
+        for (ct2=0; ct2 < api->paramCount; ct2++) {
+            const VarType *vt = &api->params[ct2];
+            if (isCapturedInput(vt)) {
+                fprintf(f, "    cap->writeData(%s, %s_length);\n", vt->name, vt->name);
+            }
+        }
+        for (ct2=0; ct2 < api->paramCount; ct2++) {
+            const VarType *vt = &api->params[ct2];
+            if ((vt->ptrLevel == 2) && vt->isConst) {
+                fprintf(f, "    for (size_t ct = 0; ct < (%s_length_length / sizeof(size_t)); ct++) {\n", vt->name);
+                fprintf(f, "        cap->writeData(%s[ct], %s_length[ct]);\n", vt->name, vt->name);
+                fprintf(f, "    }\n");
+            }
+        }
+
+        fprintf(f, "    ");
+        if (api->ret.typeName[0]) {
+            printVarType(f, &api->ret);
+            fprintf(f, " ret = ");
+        }
+        fprintf(f, "LF_%s", api->name);
+        printCallArgs(f, api, "rsc", "");
+        if (isObjectType(&api->ret)) {
+            fprintf(f, "    cap->write(&ret, sizeof(ret));\n");
+        }
+        fprintf(f, "    cap->endCommand();\n");
+        if (api->ret.typeName[0]) {
+            fprintf(f, "    return ret;\n");
+        }
+        fprintf(f, "};\n\n");
+    }
+}
+
+static void printCaptureReplayFuncs(FILE *f) {
+    int ct;
+    int ct2;
+
+    for (ct=0; ct < apiCount; ct++) {
+        const ApiEntry * api = &apis[ct];
+        if (!isCaptured(api)) {
+            continue;
+        }
+
+        fprintf(f, "void rspc_%s(Context *con, Capture *cap) {\n", api->name);
+        fprintf(f, "    RS_CMD_%s cmd;\n", api->name);
+        for (ct2=0; ct2 < api->paramCount; ct2++) {
+            const VarType *vt = &api->params[ct2];
+            if (vt->ptrLevel == 0) {
+                fprintf(f, "    cap->read(&cmd.%s, sizeof(cmd.%s));\n", vt->name, vt->name);
+            }
+        }
+        for (ct2=0; ct2 < api->paramCount; ct2++) {
+            const VarType *vt = &api->params[ct2];
+            if (vt->ptrLevel == 1) {
+                fprintf(f, "    cmd.%s = (", vt->name);
+                printVarType(f, vt);
+                fprintf(f, ")cap->%s(cmd.%s_length);\n",
+                        isCapturedInput(vt) ? "readData" : "scratch", vt->name);
+            }
+        }
+        for (ct2=0; ct2 < api->paramCount; ct2++) {
+            const VarType *vt = &api->params[ct2];
+            if ((vt->ptrLevel == 2) && vt->isConst) {
+                fprintf(f, "    cmd.%s = (", vt->name);
+                printVarType(f, vt);
+                fprintf(f, ")malloc(cmd.%s_length_length / sizeof(size_t) * sizeof(void *));\n", vt->name);
+                fprintf(f, "    for (size_t ct = 0; ct < (cmd.%s_length_length / sizeof(size_t)); ct++) {\n", vt->name);
+                fprintf(f, "        cmd.%s[ct] = (const %s *)cap->readData(cmd.%s_length[ct]);\n",
+                        vt->name, vt->typeName, vt->name);
+                fprintf(f, "    }\n");
+            }
+        }
+        for (ct2=0; ct2 < api->paramCount; ct2++) {
+            const VarType *vt = &api->params[ct2];
+            if (!isObjectType(vt)) {
+                continue;
+            }
+            if (vt->ptrLevel == 0) {
+                fprintf(f, "    cmd.%s = cap->lookupObject(cmd.%s);\n", vt->name, vt->name);
+            } else if (vt->ptrLevel == 1) {
+                fprintf(f, "    cap->lookupObjects((void *)cmd.%s, cmd.%s_length);\n", vt->name, vt->name);
+            }
+        }
+
+        fprintf(f, "    ");
+        if (isObjectType(&api->ret)) {
+            printVarType(f, &api->ret);
+            fprintf(f, " ret = ");
+        }
+        fprintf(f, "rs%s", api->name);
+        printCallArgs(f, api, "(RsContext)con", "cmd.");
+        if (isObjectType(&api->ret)) {
+            fprintf(f, "    ");
+            printVarType(f, &api->ret);
+            fprintf(f, " captured;\n");
+            fprintf(f, "    cap->read(&captured, sizeof(captured));\n");
+            fprintf(f, "    cap->addObject(captured, ret);\n");
+        }
+        for (ct2=0; ct2 < api->paramCount; ct2++) {
+            const VarType *vt = &api->params[ct2];
+            if ((vt->ptrLevel == 2) && vt->isConst) {
+                fprintf(f, "    free((void *)cmd.%s);\n", vt->name);
+            }
+        }
+        fprintf(f, "};\n\n");
+    }
+
+    fprintf(f, "RsCaptureReplayFunc gCaptureReplayFuncs[%i] = {\n", apiCount + 1);
+    fprintf(f, "    NULL,\n");
+    for (ct=0; ct < apiCount; ct++) {
+        if (isCaptured(&apis[ct])) {
+            fprintf(f, "    rspc_%s,\n", apis[ct].name);
+        } else {
+            fprintf(f, "    NULL,\n");
+        }
+    }
+    fprintf(f, "};\n\n");
+}
+
 void printApiCpp(FILE *f) {
     int ct;
     int ct2;
@@ -191,6 +416,7 @@ void printApiCpp(FILE *f) {
     fprintf(f, "#include \"rsgApiStructs.h\"\n");
     fprintf(f, "#include \"rsgApiFuncDecl.h\"\n");
     fprintf(f, "#include \"rsFifo.h\"\n");
+    fprintf(f, "#include \"rsCapture.h\"\n");
     fprintf(f, "\n");
     fprintf(f, "using namespace android;\n");
     fprintf(f, "using namespace android::renderscript;\n");
@@ -208,22 +434,18 @@ void printApiCpp(FILE *f) {
         fprintf(f, "\n{\n");
         if (api->direct) {
             fprintf(f, "    ");
-            if (api->ret.typeName[0]) {
-                fprintf(f, "return ");
-            }
-            fprintf(f, "rsi_%s(", api->name);
-            if (!api->nocontext) {
-                fprintf(f, "(Context *)rsc");
-            }
-            for (ct2=0; ct2 < api->paramCount; ct2++) {
-                const VarType *vt = &api->params[ct2];
-                if (ct2 > 0 || !api->nocontext) {
-                    fprintf(f, ", ");
-                }
-                fprintf(f, "%s", vt->name);
-            }
-            fprintf(f, ");\n");
+            printDirectCall(f, api);
         } else {
+            // Synchronous contexts skip the fifo and run the command here.
+            fprintf(f, "    if (((Context *)rsc)->isSynchronous()) {\n");
+            fprintf(f, "        Context::SyncCall sc((Context *)rsc, RS_CMD_ID_%s);\n", api->name);
+            fprintf(f, "        ");
+            printDirectCall(f, api);
+            if (!api->ret.typeName[0]) {
+                fprintf(f, "        return;\n");
+            }
+            fprintf(f, "    }\n\n");
+
             fprintf(f, "    ThreadIO *io = &((Context *)rsc)->mIO;\n");
             fprintf(f, "    const uint32_t size = sizeof(RS_CMD_%s);\n", api->name);
             if (hasInlineDataPointers(api)) {
@@ -358,6 +580,8 @@ void printApiCpp(FILE *f) {
         fprintf(f, "}\n\n");
     }
 
+    printCaptureFuncs(f);
+
     fprintf(f, "\n");
     fprintf(f, "static RsApiEntrypoints_t s_LocalTable = {\n");
     for (ct=0; ct < apiCount; ct++) {
@@ -372,7 +596,17 @@ void printApiCpp(FILE *f) {
     }
     fprintf(f, "};\n");
 
+    fprintf(f, "\n");
+    fprintf(f, "static RsApiEntrypoints_t s_CaptureTable = {\n");
+    for (ct=0; ct < apiCount; ct++) {
+        fprintf(f, "    %s_%s,\n", isCaptured(&apis[ct]) ? "CF" : "LF", apis[ct].name);
+    }
+    fprintf(f, "};\n");
+
     fprintf(f, "static RsApiEntrypoints_t *s_CurrentTable = &s_LocalTable;\n\n");
+    fprintf(f, "void Capture::installCaptureTable() {\n");
+    fprintf(f, "    s_CurrentTable = &s_CaptureTable;\n");
+    fprintf(f, "}\n\n");
     for (ct=0; ct < apiCount; ct++) {
         int needFlush = 0;
         const ApiEntry * api = &apis[ct];
@@ -411,6 +645,7 @@ void printPlaybackCpp(FILE *f) {
     fprintf(f, "#include \"rsThreadIO.h\"\n");
     fprintf(f, "#include \"rsgApiStructs.h\"\n");
     fprintf(f, "#include \"rsgApiFuncDecl.h\"\n");
+    fprintf(f, "#include \"rsCapture.h\"\n");
     fprintf(f, "\n");
     fprintf(f, "namespace android {\n");
     fprintf(f, "namespace renderscript {\n");
@@ -575,6 +810,8 @@ void printPlaybackCpp(FILE *f) {
         fprintf(f, "};\n\n");
     }
 
+    printCaptureReplayFuncs(f);
+
     fprintf(f, "RsPlaybackLocalFunc gPlaybackFuncs[%i] = {\n", apiCount + 1);
     fprintf(f, "    NULL,\n");
     for (ct=0; ct < apiCount; ct++) {
@@ -593,6 +830,13 @@ void printPlaybackCpp(FILE *f) {
     }
     fprintf(f, "};\n");
 
+    fprintf(f, "const char * gPlaybackNames[%i] = {\n", apiCount + 1);
+    fprintf(f, "    NULL,\n");
+    for (ct=0; ct < apiCount; ct++) {
+        fprintf(f, "    \"%s\",\n", apis[ct].name);
+    }
+    fprintf(f, "};\n");
+
     fprintf(f, "};\n");
     fprintf(f, "};\n");
 }
@@ -642,6 +886,9 @@ int main(int argc, char **argv) {
             fprintf(f, "typedef void (*RsPlaybackRemoteFunc)(Context *, ThreadIO *);\n");
             fprintf(f, "extern RsPlaybackLocalFunc gPlaybackFuncs[%i];\n", apiCount + 1);
             fprintf(f, "extern RsPlaybackRemoteFunc gPlaybackRemoteFuncs[%i];\n", apiCount + 1);
+            fprintf(f, "extern const char * gPlaybackNames[%i];\n", apiCount + 1);
+            fprintf(f, "typedef void (*RsCaptureReplayFunc)(Context *, Capture *);\n");
+            fprintf(f, "extern RsCaptureReplayFunc gCaptureReplayFuncs[%i];\n", apiCount + 1);
 
             fprintf(f, "}\n");
             fprintf(f, "}\n");
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times allocation snapshots below and above the driver's mmap threshold,
+// which are full copies and copy on write respectively, and the cost of
+// the first write to a page of the source afterwards.  logcat shows which
+// path each snapshot took.
+//
+// usage: rsbench-cow [snapshots]
+
+#include "rs.h"
+#include "bench.h"
+
+#include <string.h>
+
+#define PAGE_BYTES 4096
+
+static void runSnapshots(RsContext con, RsElement e, size_t bytes, int snapshots) {
+    RsType t = rsTypeCreate(con, e, bytes, 0, 0, false, false);
+    RsAllocation src = rsAllocationCreateTyped(con, t, RS_ALLOCATION_MIPMAP_NONE,
+                                               RS_ALLOCATION_USAGE_SCRIPT, 0);
+    // Touch every page so none of them are left to the zero page.
+    uint8_t *data = (uint8_t *)malloc(bytes);
+    memset(data, 0x5a, bytes);
+    rsAllocation1DData(con, src, 0, 0, bytes, data, bytes);
+    rsContextFinish(con);
+    free(data);
+
+    uint8_t page[PAGE_BYTES];
+    memset(page, 0xa5, sizeof(page));
+
+    uint64_t snapUs = 0;
+    uint64_t writeUs = 0;
+    for (int ct = 0; ct < snapshots; ct++) {
+        uint64_t start = getTimeUs();
+        RsAllocation snap = rsAllocationSnapshot(con, src);
+        uint64_t mid = getTimeUs();
+
+        page[0] = ct;
+        rsAllocation1DData(con, src, (ct * PAGE_BYTES) % bytes, 0, PAGE_BYTES,
+                           page, PAGE_BYTES);
+        rsContextFinish(con);
+        uint64_t end = getTimeUs();
+
+        snapUs += mid - start;
+        writeUs += end - mid;
+        rsObjDestroy(con, snap);
+    }
+    rsContextFinish(con);
+
+    printf("%6zu MB: snapshot %.3f ms, first page write %.1f us\n",
+           bytes / (1024 * 1024), snapUs / 1000.f / snapshots,
+           (float)writeUs / snapshots);
+    rsObjDestroy(con, src);
+    rsObjDestroy(con, t);
+}
+
+int main(int argc, char** argv)
+{
+    int snapshots = 20;
+    if (argc > 1) {
+        snapshots = atoi(argv[1]);
+    }
+
+    RsDevice dev = rsDeviceCreate();
+    RsContext con = rsContextCreate(dev, 0, 17);
+    if (!con) {
+        printf("Context creation failed\n");
+        return 1;
+    }
+
+    RsElement e = rsElementCreate(con, RS_TYPE_UNSIGNED_8, RS_KIND_USER, false, 1);
+    static const size_t sizes[] = {16, 63, 64, 256};
+    for (size_t ct = 0; ct < sizeof(sizes) / sizeof(sizes[0]); ct++) {
+        runSnapshots(con, e, sizes[ct] * 1024 * 1024, snapshots);
+    }
+
+    rsContextDestroy(con);
+    rsDeviceDestroy(dev);
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times a tight loop of small forEach launches followed by a finish, on a
+// normal context and on one created with RS_CONTEXT_SYNCHRONOUS.
+//
+// usage: rsbench-launch [launches] [size]
+
+#include "rs.h"
+#include "bench.h"
+
+static bool runLaunches(uint32_t flags, int launches, uint32_t size) {
+    RsDevice dev = rsDeviceCreate();
+    RsContext con = rsContextCreateWithFlags(dev, 0, 17, flags);
+    if (!con) {
+        printf("Context creation failed\n");
+        return false;
+    }
+
+    RsElement e = rsElementCreate(con, RS_TYPE_UNSIGNED_8, RS_KIND_PIXEL_RGBA, true, 4);
+    RsType t = rsTypeCreate(con, e, size, size, 0, false, false);
+    RsAllocation ain = rsAllocationCreateTyped(con, t, RS_ALLOCATION_MIPMAP_NONE,
+                                               RS_ALLOCATION_USAGE_SCRIPT, 0);
+    RsAllocation aout = rsAllocationCreateTyped(con, t, RS_ALLOCATION_MIPMAP_NONE,
+                                                RS_ALLOCATION_USAGE_SCRIPT, 0);
+    RsScript s = rsScriptIntrinsicCreate(con, RS_SCRIPT_INTRINSIC_ID_COLOR_MATRIX, e);
+
+    // Warm up the worker pool and the intrinsic.
+    rsScriptForEach(con, s, 0, ain, aout, NULL, 0);
+    rsContextFinish(con);
+
+    uint64_t start = getTimeUs();
+    for (int ct = 0; ct < launches; ct++) {
+        rsScriptForEach(con, s, 0, ain, aout, NULL, 0);
+    }
+    rsContextFinish(con);
+    uint64_t us = getTimeUs() - start;
+
+    printf("%s: %i launches of %ux%u in %.3f ms, %.2f us each\n",
+           (flags & RS_CONTEXT_SYNCHRONOUS) ? "synchronous" : "threaded   ",
+           launches, size, size, us / 1000.f, (float)us / launches);
+
+    rsContextDestroy(con);
+    rsDeviceDestroy(dev);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int launches = 10000;
+    uint32_t size = 16;
+    if (argc > 1) {
+        launches = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        size = atoi(argv[2]);
+    }
+
+    bool ok = runLaunches(0, launches, size) &&
+              runLaunches(RS_CONTEXT_SYNCHRONOUS, launches, size);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times generating the full mip chain of an RGBA texture.
+//
+// usage: rsbench-mipmap [size] [iterations]
+
+#include "RenderScript.h"
+#include "Element.h"
+#include "Type.h"
+#include "Allocation.h"
+#include "bench.h"
+
+using namespace android;
+using namespace renderscriptCpp;
+
+int main(int argc, char** argv)
+{
+    uint32_t size = 4096;
+    int iterations = 10;
+    if (argc > 1) {
+        size = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        iterations = atoi(argv[2]);
+    }
+
+    RenderScript *rs = new RenderScript();
+    if (!rs->init(16)) {
+        printf("Could not create a context\n");
+        return 1;
+    }
+
+    sp<const Element> e = Element::RGBA_8888(rs);
+    Type::Builder tb(rs, e);
+    tb.setX(size);
+    tb.setY(size);
+    tb.setMipmaps(true);
+    sp<const Type> t = tb.create();
+
+    sp<Allocation> a = Allocation::createTyped(rs, t, RS_ALLOCATION_MIPMAP_FULL,
+                                               RS_ALLOCATION_USAGE_SCRIPT);
+    if (a == NULL) {
+        printf("Could not create a %ux%u allocation\n", size, size);
+        return 1;
+    }
+
+    uint32_t *buf = new uint32_t[size * size];
+    for (uint32_t ct = 0; ct < size * size; ct++) {
+        buf[ct] = ct * 2654435761u;
+    }
+    a->copy2DRangeFrom(0, 0, size, size, (const int32_t *)buf, size * size * 4);
+    rs->finish();
+
+    uint64_t best = 0;
+    uint64_t total = 0;
+    for (int ct = 0; ct < iterations; ct++) {
+        uint64_t start = getTimeUs();
+        a->generateMipmaps();
+        rs->finish();
+        uint64_t us = getTimeUs() - start;
+        total += us;
+        if (!ct || (us < best)) {
+            best = us;
+        }
+    }
+
+    printf("%ux%u RGBA mip chain: %.3f ms best, %.3f ms mean over %i runs\n",
+           size, size, best / 1000.f, total / (1000.f * iterations), iterations);
+
+    delete [] buf;
+    a.clear();
+    t.clear();
+    e.clear();
+    delete rs;
+    return 0;
+}
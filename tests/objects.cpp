@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times creating and destroying small allocations from several threads
+// sharing one context.
+//
+// usage: rsbench-objects [threads] [objects per thread]
+
+#include "RenderScript.h"
+#include "Element.h"
+#include "Type.h"
+#include "Allocation.h"
+#include "bench.h"
+
+#include <pthread.h>
+
+using namespace android;
+using namespace renderscriptCpp;
+
+struct Worker {
+    RenderScript *rs;
+    sp<const Type> type;
+    int count;
+};
+
+static void * workerProc(void *data) {
+    Worker *w = (Worker *)data;
+    for (int ct = 0; ct < w->count; ct++) {
+        sp<Allocation> a = Allocation::createTyped(w->rs, w->type);
+        if (a == NULL) {
+            printf("Allocation %i failed\n", ct);
+            break;
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    int threads = 4;
+    int count = 100000;
+    if (argc > 1) {
+        threads = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        count = atoi(argv[2]);
+    }
+
+    RenderScript *rs = new RenderScript();
+    if (!rs->init(16)) {
+        printf("Could not create a context\n");
+        return 1;
+    }
+
+    sp<const Element> e = Element::U8_4(rs);
+    Type::Builder tb(rs, e);
+    tb.setX(16);
+    sp<const Type> t = tb.create();
+
+    Worker *w = new Worker[threads];
+    pthread_t *tids = new pthread_t[threads];
+    for (int ct = 0; ct < threads; ct++) {
+        w[ct].rs = rs;
+        w[ct].type = t;
+        w[ct].count = count;
+    }
+
+    uint64_t start = getTimeUs();
+    for (int ct = 0; ct < threads; ct++) {
+        pthread_create(&tids[ct], NULL, workerProc, &w[ct]);
+    }
+    for (int ct = 0; ct < threads; ct++) {
+        pthread_join(tids[ct], NULL);
+    }
+    // Destruction is queued to the context thread and held until it is
+    // idle, finish runs whatever is still pending so it is timed as well.
+    rs->finish();
+    uint64_t us = getTimeUs() - start;
+
+    printf("%i threads x %i allocations: %.3f ms, %.0f create+destroy/s\n",
+           threads, count, us / 1000.f, (double)threads * count * 1000000 / us);
+
+    delete [] tids;
+    delete [] w;
+    t.clear();
+    e.clear();
+    delete rs;
+    return 0;
+}
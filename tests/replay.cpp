@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Plays back a file recorded with rsContextStartCapture or the
+// debug.rs.capture property against a fresh context and reports the time
+// taken.
+//
+// usage: rs-replay capture-file [iterations]
+
+#include "rs.h"
+#include "rsContext.h"
+#include "rsCapture.h"
+#include "bench.h"
+
+using namespace android;
+using namespace android::renderscript;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("usage: %s capture-file [iterations]\n", argv[0]);
+        return 1;
+    }
+    int iterations = 1;
+    if (argc > 2) {
+        iterations = atoi(argv[2]);
+    }
+
+    for (int ct = 0; ct < iterations; ct++) {
+        // Replay patches object handles in place, reload for every pass.
+        Capture *cap = Capture::createReader(argv[1]);
+        if (!cap) {
+            printf("Could not load %s\n", argv[1]);
+            return 1;
+        }
+
+        RsDevice dev = rsDeviceCreate();
+        RsContext con = rsContextCreate(dev, 0, cap->getTargetSdkVersion());
+        if (!con) {
+            printf("Context creation failed\n");
+            return 1;
+        }
+
+        uint64_t start = getTimeUs();
+        bool ok = cap->replay((Context *)con);
+        rsContextFinish(con);
+        uint64_t end = getTimeUs();
+
+        printf("Pass %i: %s, %llu us\n", ct, ok ? "ok" : "failed",
+               (unsigned long long)(end - start));
+
+        delete cap;
+        rsContextDestroy(con);
+        rsDeviceDestroy(dev);
+        if (!ok) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that a 1D resize that cannot get its new buffer leaves the
+// allocation as it was.  The address space is capped just above what the
+// process uses, then a byte allocation is grown and an allocation of
+// allocations is shrunk, cutting off a live reference.
+//
+// usage: rstest-resize
+
+#include "rs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#define BYTES (128 * 1024 * 1024)
+#define HEADROOM (32 * 1024 * 1024)
+
+static size_t getVmBytes() {
+    FILE *f = fopen("/proc/self/statm", "r");
+    unsigned long pages = 0;
+    if (f) {
+        if (fscanf(f, "%lu", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(f);
+    }
+    return pages * sysconf(_SC_PAGESIZE);
+}
+
+static uint32_t getDimX(RsContext con, RsAllocation a) {
+    uint32_t data[6];
+    rsaTypeGetNativeData(con, (RsType)rsaAllocationGetType(con, a), data, 6);
+    return data[0];
+}
+
+int main(int argc, char** argv)
+{
+    RsDevice dev = rsDeviceCreate();
+    RsContext con = rsContextCreate(dev, 0, 17);
+    if (!con) {
+        printf("Context creation failed\n");
+        return 1;
+    }
+
+    RsElement e = rsElementCreate(con, RS_TYPE_UNSIGNED_8, RS_KIND_USER, false, 1);
+    RsType t = rsTypeCreate(con, e, BYTES, 0, 0, false, false);
+    RsAllocation bytes = rsAllocationCreateTyped(con, t, RS_ALLOCATION_MIPMAP_NONE,
+                                                 RS_ALLOCATION_USAGE_SCRIPT, 0);
+
+    uint32_t count = BYTES / sizeof(void *);
+    RsElement ae = rsElementCreate(con, RS_TYPE_ALLOCATION, RS_KIND_USER, false, 1);
+    RsType at = rsTypeCreate(con, ae, count, 0, 0, false, false);
+    RsAllocation refs = rsAllocationCreateTyped(con, at, RS_ALLOCATION_MIPMAP_NONE,
+                                                RS_ALLOCATION_USAGE_SCRIPT, 0);
+    if (!bytes || !refs) {
+        printf("Allocation creation failed\n");
+        return 1;
+    }
+
+    uint8_t pattern[4096];
+    for (uint32_t ct = 0; ct < sizeof(pattern); ct++) {
+        pattern[ct] = ct * 31;
+    }
+    rsAllocation1DData(con, bytes, BYTES - sizeof(pattern), 0, sizeof(pattern),
+                       pattern, sizeof(pattern));
+    // The last cell is cut off by the shrink below.
+    rsAllocation1DData(con, refs, count - 1, 0, 1, &bytes, sizeof(bytes));
+    rsContextFinish(con);
+
+    struct rlimit old;
+    getrlimit(RLIMIT_AS, &old);
+    struct rlimit lim = old;
+    lim.rlim_cur = getVmBytes() + HEADROOM;
+    if (setrlimit(RLIMIT_AS, &lim)) {
+        printf("Could not limit the address space\n");
+        return 1;
+    }
+
+    rsAllocationResize1D(con, bytes, BYTES * 2);
+    rsAllocationResize1D(con, refs, count / 4 * 3);
+    rsContextFinish(con);
+    setrlimit(RLIMIT_AS, &old);
+
+    bool ok = true;
+    if (getDimX(con, bytes) != BYTES || getDimX(con, refs) != count) {
+        printf("Failed resize changed the type\n");
+        ok = false;
+    }
+
+    uint8_t *contents = (uint8_t *)malloc(BYTES);
+    rsAllocationRead(con, bytes, contents, BYTES);
+    if (memcmp(contents + BYTES - sizeof(pattern), pattern, sizeof(pattern))) {
+        printf("Failed resize lost the contents\n");
+        ok = false;
+    }
+    free(contents);
+
+    // With memory back the shrink goes through and drops the reference.
+    rsAllocationResize1D(con, refs, count / 2);
+    rsContextFinish(con);
+    if (getDimX(con, refs) != count / 2) {
+        printf("Resize after the failure did not happen\n");
+        ok = false;
+    }
+
+    rsContextDestroy(con);
+    rsDeviceDestroy(dev);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
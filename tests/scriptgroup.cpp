@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times a ScriptGroup of three chained color matrix kernels over an RGBA
+// image, with kernel fusion and then with debug.rs.sg.no-fusion set, and
+// checks both give the same image.  Then checks a blur feeding two color
+// matrices, which has to be run a whole row at a time, against launching
+// the three kernels one by one, narrow enough to fuse and wider than any
+// tile.
+//
+// usage: rsbench-scriptgroup [size] [iterations]
+
+#include "rs.h"
+#include "bench.h"
+
+#include <cutils/properties.h>
+
+#include <string.h>
+
+#define KERNELS 3
+
+static bool runPipeline(bool fuse, uint32_t size, int iterations,
+                        const uint32_t *src, uint32_t *dst) {
+    property_set("debug.rs.sg.no-fusion", fuse ? "0" : "1");
+
+    RsDevice dev = rsDeviceCreate();
+    RsContext con = rsContextCreate(dev, 0, 17);
+    if (!con) {
+        printf("Context creation failed\n");
+        return false;
+    }
+
+    RsElement e = rsElementCreate(con, RS_TYPE_UNSIGNED_8, RS_KIND_PIXEL_RGBA, true, 4);
+    RsType t = rsTypeCreate(con, e, size, size, 0, false, false);
+    RsAllocation ain = rsAllocationCreateTyped(con, t, RS_ALLOCATION_MIPMAP_NONE,
+                                               RS_ALLOCATION_USAGE_SCRIPT, 0);
+    RsAllocation aout = rsAllocationCreateTyped(con, t, RS_ALLOCATION_MIPMAP_NONE,
+                                                RS_ALLOCATION_USAGE_SCRIPT, 0);
+    rsAllocation2DData(con, ain, 0, 0, 0, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X,
+                       size, size, src, size * size * 4);
+
+    // Each stage swaps channels so the result depends on all three.
+    float swap[16] = {0, 1, 0, 0,
+                      0, 0, 1, 0,
+                      1, 0, 0, 0,
+                      0, 0, 0, 1};
+    RsScriptKernelID kernels[KERNELS];
+    for (int ct = 0; ct < KERNELS; ct++) {
+        RsScript s = rsScriptIntrinsicCreate(con, RS_SCRIPT_INTRINSIC_ID_COLOR_MATRIX, e);
+        rsScriptSetVarV(con, s, 0, swap, sizeof(swap));
+        kernels[ct] = rsScriptKernelIDCreate(con, s, 0, 3);
+    }
+
+    RsScriptKernelID linkSrc[KERNELS - 1];
+    RsScriptKernelID linkDst[KERNELS - 1];
+    RsScriptFieldID linkField[KERNELS - 1];
+    RsType linkType[KERNELS - 1];
+    for (int ct = 0; ct < KERNELS - 1; ct++) {
+        linkSrc[ct] = kernels[ct];
+        linkDst[ct] = kernels[ct + 1];
+        linkField[ct] = NULL;
+        linkType[ct] = t;
+    }
+    RsScriptGroup sg = rsScriptGroupCreate(con, kernels, sizeof(kernels),
+                                           linkSrc, sizeof(linkSrc),
+                                           linkDst, sizeof(linkDst),
+                                           linkField, sizeof(linkField),
+                                           linkType, sizeof(linkType));
+    rsScriptGroupSetInput(con, sg, kernels[0], ain);
+    rsScriptGroupSetOutput(con, sg, kernels[KERNELS - 1], aout);
+
+    rsScriptGroupExecute(con, sg);
+    rsContextFinish(con);
+
+    uint64_t best = 0;
+    for (int ct = 0; ct < iterations; ct++) {
+        uint64_t start = getTimeUs();
+        rsScriptGroupExecute(con, sg);
+        rsContextFinish(con);
+        uint64_t us = getTimeUs() - start;
+        if (!ct || (us < best)) {
+            best = us;
+        }
+    }
+
+    // Unfused every kernel reads and writes the whole image, fused only the
+    // first read and the last write reach memory.
+    double bytes = (double)size * size * 4 * 2 * (fuse ? 1 : KERNELS);
+    printf("%s: %.3f ms best, %.1f MB moved, %.2f GB/s\n", fuse ? "fused  " : "unfused",
+           best / 1000.f, bytes / (1024 * 1024), bytes / (best * 1000.));
+
+    rsAllocationRead(con, aout, dst, size * size * 4);
+    rsContextDestroy(con);
+    rsDeviceDestroy(dev);
+    return true;
+}
+
+static bool checkBlurHead(uint32_t dimX, uint32_t dimY, const uint32_t *src) {
+    RsDevice dev = rsDeviceCreate();
+    RsContext con = rsContextCreate(dev, 0, 17);
+    if (!con) {
+        printf("Context creation failed\n");
+        return false;
+    }
+
+    RsElement e = rsElementCreate(con, RS_TYPE_UNSIGNED_8, RS_KIND_PIXEL_RGBA, true, 4);
+    RsType t = rsTypeCreate(con, e, dimX, dimY, 0, false, false);
+    RsAllocation a[4];
+    for (int ct = 0; ct < 4; ct++) {
+        a[ct] = rsAllocationCreateTyped(con, t, RS_ALLOCATION_MIPMAP_NONE,
+                                        RS_ALLOCATION_USAGE_SCRIPT, 0);
+    }
+    RsAllocation ain = a[0];
+    RsAllocation tmp = a[1];
+    RsAllocation ref = a[2];
+    RsAllocation aout = a[3];
+    rsAllocation2DData(con, ain, 0, 0, 0, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X,
+                       dimX, dimY, src, dimX * dimY * 4);
+
+    RsScript blur = rsScriptIntrinsicCreate(con, RS_SCRIPT_INTRINSIC_ID_BLUR, e);
+    float radius = 5.f;
+    rsScriptSetVarF(con, blur, 0, radius);
+    rsScriptSetVarObj(con, blur, 1, ain);
+
+    float swap[16] = {0, 1, 0, 0,
+                      0, 0, 1, 0,
+                      1, 0, 0, 0,
+                      0, 0, 0, 1};
+    RsScript cm[2];
+    for (int ct = 0; ct < 2; ct++) {
+        cm[ct] = rsScriptIntrinsicCreate(con, RS_SCRIPT_INTRINSIC_ID_COLOR_MATRIX, e);
+        rsScriptSetVarV(con, cm[ct], 0, swap, sizeof(swap));
+    }
+
+    // Reference, each kernel launched on its own over whole rows.
+    rsScriptForEach(con, blur, 0, NULL, tmp, NULL, 0);
+    rsScriptForEach(con, cm[0], 0, tmp, ref, NULL, 0);
+    rsScriptForEach(con, cm[1], 0, ref, tmp, NULL, 0);
+    rsAllocationCopy2DRange(con, ref, 0, 0, 0, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X,
+                            dimX, dimY, tmp, 0, 0, 0, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+
+    RsScriptKernelID kernels[3];
+    kernels[0] = rsScriptKernelIDCreate(con, blur, 0, 2);
+    kernels[1] = rsScriptKernelIDCreate(con, cm[0], 0, 3);
+    kernels[2] = rsScriptKernelIDCreate(con, cm[1], 0, 3);
+    RsScriptKernelID linkSrc[2] = {kernels[0], kernels[1]};
+    RsScriptKernelID linkDst[2] = {kernels[1], kernels[2]};
+    RsScriptFieldID linkField[2] = {NULL, NULL};
+    RsType linkType[2] = {t, t};
+    RsScriptGroup sg = rsScriptGroupCreate(con, kernels, sizeof(kernels),
+                                           linkSrc, sizeof(linkSrc),
+                                           linkDst, sizeof(linkDst),
+                                           linkField, sizeof(linkField),
+                                           linkType, sizeof(linkType));
+    rsScriptGroupSetOutput(con, sg, kernels[2], aout);
+    rsScriptGroupExecute(con, sg);
+
+    uint32_t *expect = new uint32_t[dimX * dimY];
+    uint32_t *result = new uint32_t[dimX * dimY];
+    rsAllocationRead(con, ref, expect, dimX * dimY * 4);
+    rsAllocationRead(con, aout, result, dimX * dimY * 4);
+    bool ok = !memcmp(expect, result, dimX * dimY * 4);
+    printf("blur head %ux%u: %s\n", dimX, dimY, ok ? "matches" : "DIFFERS");
+
+    delete [] expect;
+    delete [] result;
+    rsContextDestroy(con);
+    rsDeviceDestroy(dev);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t size = 2048;
+    int iterations = 10;
+    if (argc > 1) {
+        size = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        iterations = atoi(argv[2]);
+    }
+
+    uint32_t *src = new uint32_t[size * size];
+    uint32_t *fused = new uint32_t[size * size];
+    uint32_t *unfused = new uint32_t[size * size];
+    for (uint32_t ct = 0; ct < size * size; ct++) {
+        src[ct] = ct * 2654435761u;
+    }
+
+    bool ok = runPipeline(true, size, iterations, src, fused) &&
+              runPipeline(false, size, iterations, src, unfused);
+    property_set("debug.rs.sg.no-fusion", "0");
+    if (ok && memcmp(fused, unfused, size * size * 4)) {
+        printf("Fused and unfused results differ\n");
+        ok = false;
+    }
+
+    // One row of the intermediates fits in a worker's scratch, so the
+    // chain is fused; then wider than the tile of any launch.
+    uint32_t *wide = new uint32_t[10000 * 64];
+    for (uint32_t ct = 0; ct < 10000 * 64; ct++) {
+        wide[ct] = ct * 2654435761u;
+    }
+    ok &= checkBlurHead(1024, 64, wide);
+    ok &= checkBlurHead(10000, 64, wide);
+    delete [] wide;
+
+    delete [] src;
+    delete [] fused;
+    delete [] unfused;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that snapshots keep their contents while the source, and other
+// snapshots, are written.  The allocation is at the driver's mmap threshold
+// so snapshots share pages where the kernel supports it.
+//
+// usage: rstest-snapshot
+
+#include "rs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BYTES (64 * 1024 * 1024)
+#define WRITE_BYTES (1024 * 1024)
+
+static void fill(uint8_t *data, size_t size, uint32_t seed) {
+    for (size_t ct = 0; ct < size; ct++) {
+        data[ct] = (uint8_t)((ct >> 12) * 7 + ct * seed);
+    }
+}
+
+static void writeRange(RsContext con, RsAllocation a, uint8_t *shadow, size_t offset,
+                       uint32_t seed) {
+    uint8_t *data = shadow + offset;
+    fill(data, WRITE_BYTES, seed);
+    rsAllocation1DData(con, a, offset, 0, WRITE_BYTES, data, WRITE_BYTES);
+}
+
+static bool check(RsContext con, RsAllocation a, const uint8_t *expect,
+                  uint8_t *scratch, const char *what) {
+    rsAllocationRead(con, a, scratch, BYTES);
+    if (memcmp(scratch, expect, BYTES)) {
+        printf("%s does not hold the expected data\n", what);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    RsDevice dev = rsDeviceCreate();
+    RsContext con = rsContextCreate(dev, 0, 17);
+    if (!con) {
+        printf("Context creation failed\n");
+        return 1;
+    }
+
+    RsElement e = rsElementCreate(con, RS_TYPE_UNSIGNED_8, RS_KIND_USER, false, 1);
+    RsType t = rsTypeCreate(con, e, BYTES, 0, 0, false, false);
+    RsAllocation src = rsAllocationCreateTyped(con, t, RS_ALLOCATION_MIPMAP_NONE,
+                                               RS_ALLOCATION_USAGE_SCRIPT, 0);
+    uint8_t *srcData = (uint8_t *)malloc(BYTES);
+    uint8_t *snapData = (uint8_t *)malloc(BYTES);
+    uint8_t *scratch = (uint8_t *)malloc(BYTES);
+    if (!src || !srcData || !snapData || !scratch) {
+        printf("Allocation failed\n");
+        return 1;
+    }
+
+    fill(srcData, BYTES, 1);
+    rsAllocation1DData(con, src, 0, 0, BYTES, srcData, BYTES);
+    RsAllocation snap = rsAllocationSnapshot(con, src);
+    memcpy(snapData, srcData, BYTES);
+
+    // Writes at the start, in the middle and over the end of the source.
+    writeRange(con, src, srcData, 0, 3);
+    writeRange(con, src, srcData, BYTES / 2 + 100, 5);
+    writeRange(con, src, srcData, BYTES - WRITE_BYTES, 9);
+    rsContextFinish(con);
+
+    bool ok = check(con, snap, snapData, scratch, "Snapshot after source write") &&
+              check(con, src, srcData, scratch, "Source after write");
+
+    // A second snapshot shares the written pages, and writing the first
+    // snapshot must not reach either of the others.
+    RsAllocation snap2 = rsAllocationSnapshot(con, src);
+    uint8_t *snap2Data = (uint8_t *)malloc(BYTES);
+    memcpy(snap2Data, srcData, BYTES);
+    writeRange(con, src, srcData, 4096, 11);
+    writeRange(con, snap, snapData, BYTES / 4, 13);
+    rsContextFinish(con);
+
+    ok = ok && check(con, snap, snapData, scratch, "Written snapshot") &&
+         check(con, snap2, snap2Data, scratch, "Second snapshot") &&
+         check(con, src, srcData, scratch, "Source after second write");
+
+    // Dropping a snapshot leaves the others intact.
+    rsObjDestroy(con, snap2);
+    writeRange(con, src, srcData, BYTES / 2 + 100, 17);
+    rsContextFinish(con);
+    ok = ok && check(con, snap, snapData, scratch, "Snapshot after destroy") &&
+         check(con, src, srcData, scratch, "Source after destroy");
+
+    free(snap2Data);
+    free(scratch);
+    free(snapData);
+    free(srcData);
+    rsContextDestroy(con);
+    rsDeviceDestroy(dev);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
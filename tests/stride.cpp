@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times the Convolve3x3 and Blur intrinsics on RGBA images whose width is
+// a power of two, with the default aligned and skewed row strides and
+// then with debug.rs.alloc.align set to 1 for packed rows.
+//
+// usage: rsbench-stride [iterations]
+
+#include "rs.h"
+#include "bench.h"
+
+#include <cutils/properties.h>
+
+static uint64_t timeKernel(RsContext con, RsScript s, RsAllocation aout, int iterations) {
+    rsScriptForEach(con, s, 0, NULL, aout, NULL, 0);
+    rsContextFinish(con);
+
+    uint64_t best = 0;
+    for (int ct = 0; ct < iterations; ct++) {
+        uint64_t start = getTimeUs();
+        rsScriptForEach(con, s, 0, NULL, aout, NULL, 0);
+        rsContextFinish(con);
+        uint64_t us = getTimeUs() - start;
+        if (!ct || (us < best)) {
+            best = us;
+        }
+    }
+    return best;
+}
+
+static bool runSize(bool padded, uint32_t size, int iterations) {
+    property_set("debug.rs.alloc.align", padded ? "0" : "1");
+
+    RsDevice dev = rsDeviceCreate();
+    RsContext con = rsContextCreate(dev, 0, 17);
+    if (!con) {
+        printf("Context creation failed\n");
+        return false;
+    }
+
+    RsElement e = rsElementCreate(con, RS_TYPE_UNSIGNED_8, RS_KIND_PIXEL_RGBA, true, 4);
+    RsType t = rsTypeCreate(con, e, size, size, 0, false, false);
+    RsAllocation ain = rsAllocationCreateTyped(con, t, RS_ALLOCATION_MIPMAP_NONE,
+                                               RS_ALLOCATION_USAGE_SCRIPT, 0);
+    RsAllocation aout = rsAllocationCreateTyped(con, t, RS_ALLOCATION_MIPMAP_NONE,
+                                                RS_ALLOCATION_USAGE_SCRIPT, 0);
+
+    uint32_t *buf = new uint32_t[size * size];
+    for (uint32_t ct = 0; ct < size * size; ct++) {
+        buf[ct] = ct * 2654435761u;
+    }
+    rsAllocation2DData(con, ain, 0, 0, 0, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X,
+                       size, size, buf, size * size * 4);
+    delete [] buf;
+
+    RsScript conv = rsScriptIntrinsicCreate(con, RS_SCRIPT_INTRINSIC_ID_CONVOLVE_3x3, e);
+    float coeffs[9] = {1.f / 9, 1.f / 9, 1.f / 9,
+                       1.f / 9, 1.f / 9, 1.f / 9,
+                       1.f / 9, 1.f / 9, 1.f / 9};
+    rsScriptSetVarV(con, conv, 0, coeffs, sizeof(coeffs));
+    rsScriptSetVarObj(con, conv, 1, ain);
+
+    RsScript blur = rsScriptIntrinsicCreate(con, RS_SCRIPT_INTRINSIC_ID_BLUR, e);
+    rsScriptSetVarF(con, blur, 0, 5.f);
+    rsScriptSetVarObj(con, blur, 1, ain);
+
+    uint64_t convUs = timeKernel(con, conv, aout, iterations);
+    uint64_t blurUs = timeKernel(con, blur, aout, iterations);
+
+    double mp = (double)size * size / (1000 * 1000);
+    printf("%4u %s: convolve3x3 %.3f ms (%.1f MP/s), blur r5 %.3f ms (%.1f MP/s)\n",
+           size, padded ? "padded" : "packed",
+           convUs / 1000.f, mp * 1000000 / convUs,
+           blurUs / 1000.f, mp * 1000000 / blurUs);
+
+    rsContextDestroy(con);
+    rsDeviceDestroy(dev);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 10;
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+    }
+
+    bool ok = true;
+    uint32_t sizes[2] = {1024, 2048};
+    for (int ct = 0; ok && (ct < 2); ct++) {
+        ok = runSize(true, sizes[ct], iterations) &&
+             runSize(false, sizes[ct], iterations);
+    }
+    property_set("debug.rs.alloc.align", "0");
+    return ok ? 0 : 1;
+}
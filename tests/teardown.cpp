@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times destroying a context that still holds many objects.  Half of the
+// allocations are also referenced from an allocation of allocations, so
+// teardown has to release them through the container.
+//
+// usage: rsbench-teardown [objects]
+
+#include "rs.h"
+#include "bench.h"
+
+int main(int argc, char** argv)
+{
+    uint32_t count = 100000;
+    if (argc > 1) {
+        count = atoi(argv[1]);
+    }
+
+    RsDevice dev = rsDeviceCreate();
+    RsContext con = rsContextCreate(dev, 0, 16);
+    if (!con) {
+        printf("Context creation failed\n");
+        return 1;
+    }
+
+    RsElement e = rsElementCreate(con, RS_TYPE_UNSIGNED_8, RS_KIND_USER, false, 4);
+    RsType types[64];
+    for (uint32_t ct = 0; ct < 64; ct++) {
+        types[ct] = rsTypeCreate(con, e, ct + 1, 0, 0, false, false);
+    }
+
+    RsAllocation *allocs = new RsAllocation[count];
+    for (uint32_t ct = 0; ct < count; ct++) {
+        allocs[ct] = rsAllocationCreateTyped(con, types[ct & 63],
+                                             RS_ALLOCATION_MIPMAP_NONE,
+                                             RS_ALLOCATION_USAGE_SCRIPT, 0);
+        if (!allocs[ct]) {
+            printf("Allocation %u failed\n", ct);
+            return 1;
+        }
+    }
+
+    RsElement ae = rsElementCreate(con, RS_TYPE_ALLOCATION, RS_KIND_USER, false, 1);
+    RsType at = rsTypeCreate(con, ae, count / 2, 0, 0, false, false);
+    RsAllocation container = rsAllocationCreateTyped(con, at, RS_ALLOCATION_MIPMAP_NONE,
+                                                     RS_ALLOCATION_USAGE_SCRIPT, 0);
+    rsAllocation1DData(con, container, 0, 0, count / 2, allocs,
+                       (count / 2) * sizeof(RsAllocation));
+    rsContextFinish(con);
+
+    uint64_t start = getTimeUs();
+    rsContextDestroy(con);
+    uint64_t us = getTimeUs() - start;
+
+    printf("Teardown of %u allocations: %.3f ms\n", count, us / 1000.f);
+
+    delete [] allocs;
+    rsDeviceDestroy(dev);
+    return 0;
+}